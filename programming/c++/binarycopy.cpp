@@ -0,0 +1,155 @@
+#include "binarycopy.h"
+#include <arpa/inet.h>
+#include <cstdint>
+#include <cstring>
+
+  namespace core {
+    namespace postgresql {
+
+      namespace {
+        const char BinaryCopySignature[] = "PGCOPY\n\377\r\n";
+
+        void append16(std::string &buffer, int16_t value) {
+          uint16_t v = htons(static_cast<uint16_t>(value));
+          buffer.append(reinterpret_cast<const char *>(&v), sizeof(v));
+        }
+
+        void append32(std::string &buffer, int32_t value) {
+          uint32_t v = htonl(static_cast<uint32_t>(value));
+          buffer.append(reinterpret_cast<const char *>(&v), sizeof(v));
+        }
+
+        uint16_t read16(const char *data) {
+          uint16_t v;
+          std::memcpy(&v, data, sizeof(v));
+          return ntohs(v);
+        }
+
+        uint32_t read32(const char *data) {
+          uint32_t v;
+          std::memcpy(&v, data, sizeof(v));
+          return ntohl(v);
+        }
+
+        uint64_t read64(const char *data) {
+          return (static_cast<uint64_t>(read32(data)) << 32) | read32(data + 4);
+        }
+      } // namespace
+
+      void BinaryCopyWriter::writeHeader() {
+        if(!isHeaderWritten_) {
+          buffer_.append(BinaryCopySignature, sizeof(BinaryCopySignature)); // including the terminating zero
+          append32(buffer_, 0); // flags
+          append32(buffer_, 0); // header extension length
+          isHeaderWritten_ = true;
+        }
+      }
+
+      Error BinaryCopyWriter::addRow(const QueryData &row) {
+        size_t count = row.count();
+        for(size_t i = 0; i < count; i++) {
+          if(row.values()[i] != nullptr && row.formats()[i] != 1) {
+            return MAKE_ERROR("Unable to add copy row. Parameter %d is not in binary format", i);
+          }
+        }
+        writeHeader();
+        append16(buffer_, static_cast<int16_t>(count));
+        for(size_t i = 0; i < count; i++) {
+          if(row.values()[i] == nullptr) {
+            append32(buffer_, -1);
+          } else {
+            append32(buffer_, row.lengths()[i]);
+            buffer_.append(row.values()[i], row.lengths()[i]);
+          }
+        }
+        rowCount_++;
+        return Error::Success;
+      }
+
+      void BinaryCopyWriter::finish() {
+        writeHeader();
+        append16(buffer_, -1);
+      }
+
+      void BinaryCopyWriter::clear() {
+        buffer_.clear();
+      }
+
+      Error BinaryCopyReader::read(std::string_view data, std::vector<Field> &fields, bool &isEnd) {
+        fields.clear();
+        isEnd = false;
+        if(!isHeaderRead_) {
+          if(data.size() < sizeof(BinaryCopySignature) + 8 || std::memcmp(data.data(), BinaryCopySignature, sizeof(BinaryCopySignature)) != 0) {
+            return MAKE_ERROR("Unable to read copy data. Wrong header");
+          }
+          data.remove_prefix(sizeof(BinaryCopySignature) + 4);
+          uint32_t extensionLength = read32(data.data());
+          data.remove_prefix(4);
+          if(data.size() < extensionLength) {
+            return MAKE_ERROR("Unable to read copy data. Wrong header extension");
+          }
+          data.remove_prefix(extensionLength);
+          isHeaderRead_ = true;
+        }
+        if(data.empty()) {
+          return Error::Success;
+        }
+        if(data.size() < 2) {
+          return MAKE_ERROR("Unable to read copy data. Truncated tuple");
+        }
+        int16_t count = static_cast<int16_t>(read16(data.data()));
+        data.remove_prefix(2);
+        if(count == -1) {
+          isEnd = true;
+          return Error::Success;
+        }
+        fields.resize(count);
+        for(Field &field : fields) {
+          if(data.size() < 4) {
+            return MAKE_ERROR("Unable to read copy data. Truncated tuple");
+          }
+          int32_t length = static_cast<int32_t>(read32(data.data()));
+          data.remove_prefix(4);
+          if(length < 0) {
+            field.data = {};
+            field.isNull = true;
+            continue;
+          }
+          if(data.size() < static_cast<size_t>(length)) {
+            return MAKE_ERROR("Unable to read copy data. Truncated field");
+          }
+          field.data = data.substr(0, length);
+          field.isNull = false;
+          data.remove_prefix(length);
+        }
+        return Error::Success;
+      }
+
+      int16_t BinaryCopyReader::Field::toInt16() const {
+        return data.size() == 2 ? static_cast<int16_t>(read16(data.data())) : 0;
+      }
+
+      int32_t BinaryCopyReader::Field::toInt32() const {
+        return data.size() == 4 ? static_cast<int32_t>(read32(data.data())) : 0;
+      }
+
+      int64_t BinaryCopyReader::Field::toInt64() const {
+        return data.size() == 8 ? static_cast<int64_t>(read64(data.data())) : 0;
+      }
+
+      bool BinaryCopyReader::Field::toBool() const {
+        return data.size() == 1 && data[0] != 0;
+      }
+
+      double BinaryCopyReader::Field::toDouble() const {
+        if(data.size() != 8) {
+          return 0;
+        }
+        uint64_t v = read64(data.data());
+        double result;
+        std::memcpy(&result, &v, sizeof(result));
+        return result;
+      }
+
+    } // namespace postgresql
+  }   // namespace core
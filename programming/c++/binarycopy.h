@@ -0,0 +1,67 @@
+#pragma once
+#include "core/common/error.h"
+#include "querydata.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+  namespace core {
+    namespace postgresql {
+
+      // builds the data stream of COPY ... FROM STDIN (FORMAT binary). Rows take the same binary parameters as QueryData
+      class BinaryCopyWriter {
+      public:
+        Error addRow(const QueryData &row);
+        void finish();
+
+        std::string_view data() const;
+        size_t rowCount() const;
+        // drops data already passed to the connection, the header is not repeated
+        void clear();
+
+      private:
+        void writeHeader();
+
+      private:
+        std::string buffer_;
+        size_t rowCount_ = 0;
+        bool isHeaderWritten_ = false;
+      };
+
+      // parses rows of COPY ... TO STDOUT (FORMAT binary) as they come from Connection::copyTo. Fields point into the row data
+      class BinaryCopyReader {
+      public:
+        struct Field {
+          std::string_view data;
+          bool isNull = false;
+
+          int16_t toInt16() const;
+          int32_t toInt32() const;
+          int64_t toInt64() const;
+          bool toBool() const;
+          double toDouble() const;
+          std::string_view toString() const;
+        };
+
+      public:
+        // fields is empty when data holds no tuple, isEnd is set by the trailer
+        Error read(std::string_view data, std::vector<Field> &fields, bool &isEnd);
+
+      private:
+        bool isHeaderRead_ = false;
+      };
+
+      inline std::string_view BinaryCopyReader::Field::toString() const {
+        return data;
+      }
+
+      inline std::string_view BinaryCopyWriter::data() const {
+        return buffer_;
+      }
+      inline size_t BinaryCopyWriter::rowCount() const {
+        return rowCount_;
+      }
+
+    } // namespace postgresql
+  }   // namespace core
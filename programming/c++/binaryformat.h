@@ -0,0 +1,347 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+  namespace core {
+    namespace postgresql {
+
+      // postgres binary wire format of the C++ types used as query parameters
+      template <typename T>
+      struct BinaryFormat;
+
+      using UuidBytes = std::array<uint8_t, 16>;
+
+      namespace binary {
+        constexpr unsigned int BoolOid = 16;
+        constexpr unsigned int Int8Oid = 20;
+        constexpr unsigned int Int2Oid = 21;
+        constexpr unsigned int Int4Oid = 23;
+        constexpr unsigned int TextOid = 25;
+        constexpr unsigned int Float4Oid = 700;
+        constexpr unsigned int Float8Oid = 701;
+        constexpr unsigned int BoolArrayOid = 1000;
+        constexpr unsigned int Int2ArrayOid = 1005;
+        constexpr unsigned int Int4ArrayOid = 1007;
+        constexpr unsigned int TextArrayOid = 1009;
+        constexpr unsigned int Int8ArrayOid = 1016;
+        constexpr unsigned int Float4ArrayOid = 1021;
+        constexpr unsigned int Float8ArrayOid = 1022;
+        constexpr unsigned int TimestampTzOid = 1184;
+        constexpr unsigned int TimestampTzArrayOid = 1185;
+        constexpr unsigned int UuidOid = 2950;
+        constexpr unsigned int UuidArrayOid = 2951;
+
+        // microseconds between the unix epoch and the postgres epoch 2000-01-01
+        constexpr int64_t PostgresEpochOffset = 946684800LL * 1000000LL;
+
+        template <typename T>
+        void appendInteger(std::string &out, T value) {
+          using U = std::make_unsigned_t<T>;
+          U v = static_cast<U>(value);
+          char bytes[sizeof(T)];
+          for(size_t i = 0; i < sizeof(T); i++) {
+            bytes[i] = static_cast<char>(v >> (8 * (sizeof(T) - 1 - i)));
+          }
+          out.append(bytes, sizeof(T));
+        }
+
+        template <typename T>
+        T readInteger(const char *data) {
+          using U = std::make_unsigned_t<T>;
+          U v = 0;
+          for(size_t i = 0; i < sizeof(T); i++) {
+            v = static_cast<U>((v << 8) | static_cast<uint8_t>(data[i]));
+          }
+          return static_cast<T>(v);
+        }
+
+        template <typename T>
+        struct IsOptional : std::false_type {};
+        template <typename T>
+        struct IsOptional<std::optional<T>> : std::true_type {};
+      } // namespace binary
+
+      template <>
+      struct BinaryFormat<bool> {
+        static constexpr unsigned int oid = binary::BoolOid;
+        static constexpr unsigned int arrayOid = binary::BoolArrayOid;
+        static void encode(std::string &out, bool value) {
+          out.push_back(value ? 1 : 0);
+        }
+        static bool decode(const char *data, int) {
+          return data[0] != 0;
+        }
+      };
+
+      template <>
+      struct BinaryFormat<int16_t> {
+        static constexpr unsigned int oid = binary::Int2Oid;
+        static constexpr unsigned int arrayOid = binary::Int2ArrayOid;
+        static void encode(std::string &out, int16_t value) {
+          binary::appendInteger(out, value);
+        }
+        static int16_t decode(const char *data, int) {
+          return binary::readInteger<int16_t>(data);
+        }
+      };
+
+      template <>
+      struct BinaryFormat<int32_t> {
+        static constexpr unsigned int oid = binary::Int4Oid;
+        static constexpr unsigned int arrayOid = binary::Int4ArrayOid;
+        static void encode(std::string &out, int32_t value) {
+          binary::appendInteger(out, value);
+        }
+        static int32_t decode(const char *data, int) {
+          return binary::readInteger<int32_t>(data);
+        }
+      };
+
+      template <>
+      struct BinaryFormat<int64_t> {
+        static constexpr unsigned int oid = binary::Int8Oid;
+        static constexpr unsigned int arrayOid = binary::Int8ArrayOid;
+        static void encode(std::string &out, int64_t value) {
+          binary::appendInteger(out, value);
+        }
+        static int64_t decode(const char *data, int) {
+          return binary::readInteger<int64_t>(data);
+        }
+      };
+
+      template <>
+      struct BinaryFormat<float> {
+        static constexpr unsigned int oid = binary::Float4Oid;
+        static constexpr unsigned int arrayOid = binary::Float4ArrayOid;
+        static void encode(std::string &out, float value) {
+          uint32_t v;
+          std::memcpy(&v, &value, sizeof(v));
+          binary::appendInteger(out, v);
+        }
+        static float decode(const char *data, int) {
+          uint32_t v = binary::readInteger<uint32_t>(data);
+          float value;
+          std::memcpy(&value, &v, sizeof(value));
+          return value;
+        }
+      };
+
+      template <>
+      struct BinaryFormat<double> {
+        static constexpr unsigned int oid = binary::Float8Oid;
+        static constexpr unsigned int arrayOid = binary::Float8ArrayOid;
+        static void encode(std::string &out, double value) {
+          uint64_t v;
+          std::memcpy(&v, &value, sizeof(v));
+          binary::appendInteger(out, v);
+        }
+        static double decode(const char *data, int) {
+          uint64_t v = binary::readInteger<uint64_t>(data);
+          double value;
+          std::memcpy(&value, &v, sizeof(value));
+          return value;
+        }
+      };
+
+      template <>
+      struct BinaryFormat<std::string_view> {
+        static constexpr unsigned int oid = binary::TextOid;
+        static constexpr unsigned int arrayOid = binary::TextArrayOid;
+        static void encode(std::string &out, std::string_view value) {
+          out.append(value);
+        }
+        // points into the result buffer, valid while the result is alive
+        static std::string_view decode(const char *data, int length) {
+          return {data, static_cast<size_t>(length)};
+        }
+      };
+
+      template <>
+      struct BinaryFormat<std::string> : BinaryFormat<std::string_view> {
+        static std::string decode(const char *data, int length) {
+          return {data, static_cast<size_t>(length)};
+        }
+      };
+
+      template <>
+      struct BinaryFormat<UuidBytes> {
+        static constexpr unsigned int oid = binary::UuidOid;
+        static constexpr unsigned int arrayOid = binary::UuidArrayOid;
+        static void encode(std::string &out, const UuidBytes &value) {
+          out.append(reinterpret_cast<const char *>(value.data()), value.size());
+        }
+        static UuidBytes decode(const char *data, int) {
+          UuidBytes value;
+          std::memcpy(value.data(), data, value.size());
+          return value;
+        }
+      };
+
+      template <>
+      struct BinaryFormat<std::chrono::system_clock::time_point> {
+        static constexpr unsigned int oid = binary::TimestampTzOid;
+        static constexpr unsigned int arrayOid = binary::TimestampTzArrayOid;
+        static void encode(std::string &out, std::chrono::system_clock::time_point value) {
+          int64_t microseconds = std::chrono::duration_cast<std::chrono::microseconds>(value.time_since_epoch()).count();
+          binary::appendInteger(out, microseconds - binary::PostgresEpochOffset);
+        }
+        static std::chrono::system_clock::time_point decode(const char *data, int) {
+          int64_t microseconds = binary::readInteger<int64_t>(data) + binary::PostgresEpochOffset;
+          return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::microseconds(microseconds)));
+        }
+      };
+
+      // one dimensional array without nulls
+      template <typename T>
+      struct BinaryFormat<std::vector<T>> {
+        static constexpr unsigned int oid = BinaryFormat<T>::arrayOid;
+        static void encode(std::string &out, const std::vector<T> &value) {
+          binary::appendInteger(out, int32_t(1));
+          binary::appendInteger(out, int32_t(0));
+          binary::appendInteger(out, static_cast<int32_t>(BinaryFormat<T>::oid));
+          binary::appendInteger(out, static_cast<int32_t>(value.size()));
+          binary::appendInteger(out, int32_t(1));
+          for(const T &item : value) {
+            size_t lengthOffset = out.size();
+            binary::appendInteger(out, int32_t(0));
+            BinaryFormat<T>::encode(out, item);
+            int32_t length = static_cast<int32_t>(out.size() - lengthOffset - sizeof(int32_t));
+            for(size_t i = 0; i < sizeof(int32_t); i++) {
+              out[lengthOffset + i] = static_cast<char>(static_cast<uint32_t>(length) >> (8 * (3 - i)));
+            }
+          }
+        }
+        // null elements are decoded as T{}, multidimensional arrays are flattened
+        static std::vector<T> decode(const char *data, int length) {
+          std::vector<T> value;
+          decode(data, length, value);
+          return value;
+        }
+        static void decode(const char *data, int length, std::vector<T> &value) {
+          const char *end = data + length;
+          if(length < 12) {
+            return;
+          }
+          int32_t dimensions = binary::readInteger<int32_t>(data);
+          data += 12;
+          if(dimensions <= 0 || end - data < 8 * dimensions) {
+            return;
+          }
+          size_t count = 1;
+          for(int32_t i = 0; i < dimensions; i++) {
+            count *= static_cast<size_t>(binary::readInteger<int32_t>(data));
+            data += 8;
+          }
+          value.reserve(value.size() + count);
+          for(size_t i = 0; i < count && end - data >= 4; i++) {
+            int32_t itemLength = binary::readInteger<int32_t>(data);
+            data += 4;
+            if(itemLength < 0) {
+              value.emplace_back();
+              continue;
+            }
+            if(end - data < itemLength) {
+              return;
+            }
+            value.push_back(BinaryFormat<T>::decode(data, itemLength));
+            data += itemLength;
+          }
+        }
+      };
+
+      template <typename T>
+      struct BinaryFormat<std::optional<T>> {
+        static constexpr unsigned int oid = BinaryFormat<T>::oid;
+      };
+
+      namespace binary {
+        constexpr unsigned int TimestampOid = 1114;
+
+        // result column types that can be decoded into T
+        template <typename T>
+        constexpr bool isCompatible(unsigned int oid) {
+          if constexpr(IsOptional<T>::value) {
+            return isCompatible<typename T::value_type>(oid);
+          } else if constexpr(std::is_same_v<T, std::chrono::system_clock::time_point>) {
+            // timestamp and timestamptz share the binary representation
+            return oid == TimestampTzOid || oid == TimestampOid;
+          } else {
+            return oid == BinaryFormat<T>::oid;
+          }
+        }
+      } // namespace binary
+
+      struct ParameterView {
+        int count;
+        const char *const *values;
+        const int *lengths;
+        const int *formats;
+      };
+
+      // encodes the parameters into the arena without any other allocation. The arena is reused by the next call,
+      // libpq copies the values when the query is sent
+      template <typename... Args>
+      class QueryParameters {
+      public:
+        static constexpr size_t Count = sizeof...(Args);
+        static constexpr std::array<unsigned int, Count> types = {BinaryFormat<std::decay_t<Args>>::oid...};
+
+      public:
+        QueryParameters(std::string &arena, const Args &...args) {
+          arena.clear();
+          size_t offsets[Count + 1];
+          size_t index = 0;
+          (encode(arena, args, offsets, index), ...);
+          for(size_t i = 0; i < Count; i++) {
+            formats_[i] = 1;
+            if(offsets[i] == NullOffset) {
+              values_[i] = nullptr;
+              lengths_[i] = 0;
+            } else {
+              values_[i] = arena.data() + offsets[i];
+              lengths_[i] = static_cast<int>(ends_[i] - offsets[i]);
+            }
+          }
+        }
+
+        ParameterView view() const {
+          return {static_cast<int>(Count), values_.data(), lengths_.data(), formats_.data()};
+        }
+
+      private:
+        static constexpr size_t NullOffset = static_cast<size_t>(-1);
+
+        template <typename T>
+        void encode(std::string &arena, const T &value, size_t *offsets, size_t &index) {
+          if constexpr(binary::IsOptional<T>::value) {
+            if(!value) {
+              offsets[index] = NullOffset;
+              ends_[index] = 0;
+              index++;
+              return;
+            }
+            encode(arena, *value, offsets, index);
+          } else {
+            offsets[index] = arena.size();
+            BinaryFormat<std::decay_t<T>>::encode(arena, value);
+            ends_[index] = arena.size();
+            index++;
+          }
+        }
+
+      private:
+        std::array<const char *, Count> values_;
+        std::array<int, Count> lengths_;
+        std::array<int, Count> formats_;
+        std::array<size_t, Count> ends_;
+      };
+
+    } // namespace postgresql
+  }   // namespace core
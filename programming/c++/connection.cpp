@@ -4,84 +4,198 @@
 #include "core/microservice/logger.h"
 #include "core/network/dnsresolver.h"
 #include "core/network/ssl/utils.h"
+#include "dnscache.h"
 #include "recordset.h"
+#include "sslcredentials.h"
+#include "statementregistry.h"
+#include "statistics.h"
 #include <libpq-fe.h>
+#include <algorithm>
+#include <deque>
+#include <random>
 #include <openssl/x509.h>
+#include <tuple>
+#include <unordered_map>
 #include <unistd.h>
 #include <uv.h>
 
   namespace core {
     namespace postgresql {
 
-      Error Connection::SslTmpFile::create(std::string_view data) {
-        f_ = std::tmpfile();
-        if(!f_) {
-          return MAKE_ERROR("Unable to create temporary ssl file. %s", strerror(errno));
-        }
-        std::fwrite(data.data(), data.size(), 1, f_);
-        std::fflush(f_);
-        path_ = "/proc/self/fd/" + std::to_string(fileno(f_));
-        return Error::Success;
-      }
-      void Connection::SslTmpFile::clear() {
-        if(f_) {
-          fclose(f_);
-          f_ = nullptr;
-        }
-        path_.clear();
-      }
-
-      Connection::SslTmpFile::~SslTmpFile() {
-        if(f_) {
-          fclose(f_);
-        }
-      }
-
-      const std::string &Connection::SslTmpFile::path() const {
-        return path_;
-      }
-
-      void Connection::SslTemporaryFiles::clear() {
-        certificate_.clear();
-        key_.clear();
-        ca_.clear();
-      }
-
       class Connection::ConnectionImpl {
       public:
         enum class State {
           Disconnected,
           Connecting,
           Connected,
+          Resetting,
           Disconnecting
         };
 
+      public:
+        struct Request {
+          enum class Type {
+            Execute,
+            Prepare,
+            Multi
+          };
+          Type type = Type::Execute;
+          ExecuteHandler handler;
+          PrepareHandler prepareHandler;
+          MultiExecuteHandler multiHandler;
+          std::vector<Recordset> results;
+          RowHandler rowHandler;
+          CopyInHandler copyInHandler;
+          CopyOutHandler copyOutHandler;
+          std::string_view copyData;
+          RequestId id = InvalidRequestId;
+          std::chrono::steady_clock::time_point deadline;
+          std::string name;
+          StatementId statementId = InvalidStatementId;
+          // results of a lazy prepare and describe sent ahead of the execute
+          int prepareResults = 0;
+          bool isDescribing = false;
+          Error error = Error::Success;
+          Recordset result;
+          bool hasResult = false;
+          bool isDescribePending = false;
+          bool isCopyIn = false;
+          bool isCopyInFinished = false;
+          bool isCopyOut = false;
+          // completed by timeout or cancel, the results are still read and dropped
+          bool isAbandoned = false;
+          // LISTEN commands of the subscriptions, not counted against the pipeline depth
+          bool isInternal = false;
+          std::chrono::steady_clock::time_point sendTime;
+          Statistics::Series *statementSeries = nullptr;
+          bool isSent = false;
+          bool isFirstResultReceived = false;
+        };
+
+        struct StringHash {
+          using is_transparent = void;
+          size_t operator()(std::string_view value) const {
+            return std::hash<std::string_view>()(value);
+          }
+        };
+
+        // synchronous functions are not allowed in pipeline mode, so an idle connection leaves it for their duration
+        class PipelineSuspender {
+        public:
+          PipelineSuspender(PGconn *handle) : handle_(handle), isSuspended_(PQpipelineStatus(handle) == PQ_PIPELINE_ON && PQexitPipelineMode(handle) == 1) {}
+          ~PipelineSuspender() {
+            if(isSuspended_) {
+              PQenterPipelineMode(handle_);
+            }
+          }
+
+        private:
+          PGconn *handle_;
+          bool isSuspended_;
+        };
+
       public:
         ConnectionImpl(AsyncObjectPtr<Connection> base) :
             base_(base),
-            requestId_(InvalidRequestId),
-            connectTimer_(ConstructTag(STRING_VIEW("core::postgresql::Connection::ConnectionImpl::startTimer")), base->eventLoop()) {
+            maxPipelineDepth_(base->maxPipelineDepth_),
+            connectTimer_(ConstructTag(STRING_VIEW("core::postgresql::Connection::ConnectionImpl::startTimer")), base->eventLoop()),
+            requestTimer_(ConstructTag(STRING_VIEW("core::postgresql::Connection::ConnectionImpl::requestTimer")), base->eventLoop()),
+            attemptTimer_(ConstructTag(STRING_VIEW("core::postgresql::Connection::ConnectionImpl::attemptTimer")), base->eventLoop()) {
           state_ = State::Connecting;
+          if(Statistics::instance()->isEnabled()) {
+            statistics_ = Statistics::instance()->connectionSeries(base_->hostIndex_, base_->id_);
+            stageStart_ = std::chrono::steady_clock::now();
+          }
           connectTimer_->restart(base_->options().connectTimeout(), [this]() {
             reconnect(MAKE_ERROR("Connection timeout"));
           });
+          const std::string &host = base_->options().hosts()[base_->hostIndex_];
+          if(DnsCache::instance()->get(host, addresses_)) {
+            // connect is not started from the constructor, a failure would destroy the object being constructed
+            attemptTimer_->restart(std::chrono::milliseconds(0), [this]() {
+              onResolved();
+            });
+            return;
+          }
           network::DnsResolver::instance()->resolve(
-              base_->options().hosts()[base_->hostIndex_],
+              host,
               [this](const std::vector<core::network::Address> &addresses) {
                 dnsRequestId_ = {};
                 if(!base_) {
                   return;
                 }
-                if(addresses.empty()) {
-                  reconnect(MAKE_ERROR("Unable to resolve host address \"%s\"", base_->options().hosts()[base_->hostIndex_].c_str()));
-                  return;
+                std::vector<std::string> resolved;
+                resolved.reserve(addresses.size());
+                for(const core::network::Address &address : addresses) {
+                  resolved.push_back(address.toString());
                 }
-                connect(addresses[0].toString());
+                addresses_ = resolved;
+                DnsCache::instance()->put(base_->options().hosts()[base_->hostIndex_], std::move(resolved));
+                onResolved();
                 return;
               },
               &dnsRequestId_);
         }
 
+        void onResolved() {
+          if(statistics_) {
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            statistics_->record(Statistics::Stage::Dns, now - stageStart_);
+            stageStart_ = now;
+          }
+          if(addresses_.empty()) {
+            reconnect(MAKE_ERROR("Unable to resolve host address \"%s\"", base_->options().hosts()[base_->hostIndex_].c_str()));
+            return;
+          }
+          connectNext();
+        }
+
+        // addresses are tried one after another, each one gets an equal share of the connect timeout
+        void connectNext() {
+          const std::string &address = addresses_[addressIndex_++];
+          if(addressIndex_ < addresses_.size()) {
+            std::chrono::milliseconds timeout = std::max(base_->options().connectTimeout() / static_cast<int64_t>(addresses_.size()), std::chrono::milliseconds(1));
+            attemptTimer_->restart(timeout, [this]() {
+              failAttempt(MAKE_ERROR("Connection timeout"));
+            });
+          }
+          connect(address);
+        }
+
+        void failAttempt(const Error &error) {
+          attemptTimer_->stop();
+          if(addressIndex_ >= addresses_.size()) {
+            DnsCache::instance()->invalidate(base_->options().hosts()[base_->hostIndex_]);
+            reconnect(error);
+            return;
+          }
+          closeHandle();
+          connectNext();
+        }
+
+        void closeHandle() {
+          closePoll();
+          if(handle_ != nullptr) {
+            PQfinish(handle_);
+            handle_ = nullptr;
+          }
+        }
+
+        void closePoll() {
+          if(pollHandle_) {
+            uv_poll_stop(pollHandle_);
+            uv_handle_set_data(reinterpret_cast<uv_handle_t *>(pollHandle_), nullptr);
+            uv_close(reinterpret_cast<uv_handle_t *>(pollHandle_), [](uv_handle_t *poll) {
+              delete reinterpret_cast<uv_poll_t *>(poll);
+            });
+            pollHandle_ = nullptr;
+          }
+          if(fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+          }
+        }
+
         ~ConnectionImpl() {
           disconnect();
         }
@@ -106,17 +220,17 @@
             keywords.push_back("host");
             values.push_back(base_->options().hosts()[base_->hostIndex_].c_str());
             keywords.push_back("sslmode");
-            if(!base_->sslTemporaryFiles_.ca_.path().empty()) {
+            if(!base_->sslCredentials_->caPath().empty()) {
               values.push_back("verify-full");
               keywords.push_back("sslrootcert");
-              values.push_back(base_->sslTemporaryFiles_.ca_.path().c_str());
+              values.push_back(base_->sslCredentials_->caPath().c_str());
             } else {
               values.push_back("require");
             }
             keywords.push_back("sslcert");
-            values.push_back(base_->sslTemporaryFiles_.certificate_.path().c_str());
+            values.push_back(base_->sslCredentials_->certificatePath().c_str());
             keywords.push_back("sslkey");
-            values.push_back(base_->sslTemporaryFiles_.key_.path().c_str());
+            values.push_back(base_->sslCredentials_->keyPath().c_str());
 
           } else {
             keywords.push_back("password");
@@ -129,12 +243,12 @@
           values.push_back(nullptr);
           handle_ = PQconnectStartParams(keywords.data(), values.data(), base_->options().databaseName().empty() ? 0 : 1);
           if(handle_ == nullptr) {
-            reconnect(MAKE_ERROR("Connection to database failed."));
+            failAttempt(MAKE_ERROR("Connection to database failed."));
             return;
           }
           ConnStatusType status = PQstatus(handle_);
           if(status != CONNECTION_STARTED) {
-            reconnect(MAKE_ERROR("Connection to database failed. %s", PQerrorMessage(handle_)));
+            failAttempt(MAKE_ERROR("Connection to database failed. %s", PQerrorMessage(handle_)));
             return;
           }
 
@@ -149,32 +263,66 @@
               },
               nullptr);
 
+          Error error = startPoll();
+          if(error.isFail()) {
+            failAttempt(error);
+            return;
+          }
+        }
+
+        // the socket changes with every connect and reset, so it is duplicated and polled again each time
+        Error startPoll() {
           int fd = PQsocket(handle_);
           if(fd < 0) {
-            reconnect(MAKE_ERROR("Unable to get socket description"));
-            return;
+            return MAKE_ERROR("Unable to get socket description");
           }
 
           fd_ = fcntl(fd, F_DUPFD_CLOEXEC, 0);
           if(fd_ < 0) {
-            reconnect(MAKE_ERROR("Unable to duplicate socket description"));
-            return;
+            return MAKE_ERROR("Unable to duplicate socket description");
           }
           base_->options().socketOptions().apply(fd);
           pollHandle_ = new uv_poll_t;
           uv_poll_init(base_->eventLoop()->handle(), pollHandle_, fd_);
           uv_handle_set_data(reinterpret_cast<uv_handle_t *>(pollHandle_), this);
-          Error error = pollConnection();
-          if(error.isFail()) {
-            reconnect(error);
-            return;
+          return pollConnection();
+        }
+
+        // a lost connection is first reset in place: the PGconn with its parameters and ssl files is reused and
+        // there is no dns lookup. The full reconnect with backoff is used when the reset fails
+        Error startReset() {
+          closePoll();
+          requestTimer_->stop();
+          requestTimerDeadline_ = {};
+          preparedStatements_.clear();
+          preparedStmtOids_.clear();
+          isReadingPaused_ = false;
+          isReset_ = true;
+          state_ = State::Resetting;
+          if(PQresetStart(handle_) != 1) {
+            return MAKE_ERROR("Unable to reset connection. %s", PQerrorMessage(handle_));
           }
+          connectTimer_->restart(base_->options().connectTimeout(), [this]() {
+            reconnect(MAKE_ERROR("Connection timeout"));
+          });
+          return startPoll();
         }
 
+        // requests still in flight complete with an error after the teardown, an awaiting coroutine is always resumed
         void disconnect() {
           state_ = State::Disconnecting;
 
           if(base_) {
+            AsyncObjectPtr<Connection> base = base_;
+            std::deque<Request> requests = std::move(requests_);
+            requests_.clear();
+            if(statistics_) {
+              for(Request &request : requests) {
+                if(!request.isAbandoned) {
+                  recordCompletion(request, false);
+                }
+              }
+            }
             base_->connectionImpl_ = nullptr;
             base_.reset();
             if(dnsRequestId_) {
@@ -182,6 +330,8 @@
               dnsRequestId_ = {};
             }
             connectTimer_->stop();
+            requestTimer_->stop();
+            attemptTimer_->stop();
             if(handle_ != nullptr) {
               if(fd_ >= 0) {
                 close(fd_);
@@ -202,49 +352,213 @@
             } else {
               delete this;
             }
+            for(Request &request : requests) {
+              request.error = MAKE_ERROR("Connection is destroyed");
+              completeRequest(request, base);
+            }
           }
         }
 
         void reconnect(const Error &error) {
           AsyncObjectPtr<Connection> base = base_;
-          disconnect();
-          if(base) {
-            if(base->options().isAutoReconnect()) {
+          // a connection is reset once, when it is lost again the full reconnect with backoff follows
+          bool isResettable = base && state_ == State::Connected && !isReset_ && handle_ != nullptr && base->options().isAutoReconnect();
+          // the reset went to the address that was just lost, the full reconnect resolves the host again and tries all addresses
+          if(base && state_ == State::Resetting) {
+            DnsCache::instance()->invalidate(base->options().hosts()[base->hostIndex_]);
+          }
+          std::deque<Request> requests = std::move(requests_);
+          requests_.clear();
+          internalRequests_ = 0;
+          if(statistics_) {
+            statistics_->increment(Statistics::Counter::Disconnects);
+            for(Request &request : requests) {
+              if(!request.isAbandoned) {
+                recordCompletion(request, false);
+              }
+            }
+            // kept across failed attempts until the connection is ready again
+            if(base && state_ == State::Connected) {
+              base->disconnectTime_ = std::chrono::steady_clock::now();
+            }
+          }
+          if(isResettable) {
+            state_ = State::Resetting;
+          } else {
+            disconnect();
+            if(base && base->options().isAutoReconnect()) {
               base->startReconnectTimer();
             }
+          }
+          if(base) {
+            for(Request &request : requests) {
+              request.error = MAKE_CHILD_ERROR(error, "Connection lost");
+              completeRequest(request, base);
+            }
             if(base->disconnectedHandler_) {
               base->disconnectedHandler_(error);
             }
           }
+          // handlers may have destroyed the connection
+          if(isResettable && base_ && startReset().isFail()) {
+            DnsCache::instance()->invalidate(base->options().hosts()[base->hostIndex_]);
+            disconnect();
+            base->startReconnectTimer();
+          }
         }
 
-        void finishRequest(const Error &error, Recordset &&result) {
-          ExecuteHandler executeHandler = std::move(executeHandler_);
-          isExecuting_ = false;
-          executeHandler_ = {};
-          requestId_ = InvalidRequestId;
-          if(executeHandler) {
-            if(error.isFail()) {
-              executeHandler(error, std::move(result), base_);
-              return;
-            } else {
-              executeHandler(Error::Success, std::move(result), base_);
-              return;
+        void finishRequest() {
+          Request &front = requests_.front();
+          if(front.type == Request::Type::Prepare && front.error.isSuccess()) {
+            // without pipeline the statement is described once the prepare itself completed
+            if(front.isDescribePending) {
+              front.isDescribePending = false;
+              front.hasResult = false;
+              if(PQsendDescribePrepared(handle_, front.name.c_str()) == 0) {
+                front.error = MAKE_ERROR("Unable to describe prepared statement. %s", PQerrorMessage(handle_));
+              } else {
+                // the describe is on its way, its result would be taken for the next request
+                Error error = flush();
+                if(error.isFail()) {
+                  reconnect(error);
+                }
+                return;
+              }
+            } else if(front.hasResult) {
+              preparedStmtOids_.insert_or_assign(front.name, parameterTypes(front.result.handle()));
+            }
+          }
+          Request request = std::move(front);
+          requests_.pop_front();
+          if(request.isInternal) {
+            internalRequests_--;
+          }
+          if(requests_.empty()) {
+            restorePipelineMode();
+          }
+          if(statistics_ && !request.isAbandoned) {
+            recordCompletion(request, request.error.isSuccess());
+          }
+          completeRequest(request, base_);
+          // the handler goes first, LISTEN commands held back meanwhile follow its requests
+          if(base_) {
+            sendPendingListen();
+          }
+        }
+
+        void recordCompletion(const Request &request, bool isSuccess) {
+          std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now() - request.sendTime;
+          statistics_->record(Statistics::Stage::Complete, duration);
+          if(!isSuccess) {
+            statistics_->increment(Statistics::Counter::Errors);
+          }
+          if(request.statementSeries) {
+            request.statementSeries->record(Statistics::Stage::Complete, duration);
+            if(!isSuccess) {
+              request.statementSeries->increment(Statistics::Counter::Errors);
+            }
+          }
+        }
+
+        void recordFirstResult(Request &request) {
+          request.isFirstResultReceived = true;
+          std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now() - request.sendTime;
+          statistics_->record(Statistics::Stage::FirstByte, duration);
+          if(request.statementSeries) {
+            request.statementSeries->record(Statistics::Stage::FirstByte, duration);
+          }
+        }
+
+        // series of the statement is looked up once per connection
+        void setStatement(Request &request, std::string_view name) {
+          if(!statistics_) {
+            return;
+          }
+          std::unordered_map<std::string, Statistics::Series *, StringHash, std::equal_to<>>::const_iterator i = statementSeries_.find(name);
+          if(i == statementSeries_.end()) {
+            i = statementSeries_.emplace(std::string(name), Statistics::instance()->statementSeries(base_->hostIndex_, name)).first;
+          }
+          request.statementSeries = i->second;
+          request.statementSeries->increment(Statistics::Counter::Requests);
+        }
+
+        // registry statements find their series by id, series are per host and thread so they are kept per connection
+        void setStatement(Request &request, StatementId statementId, std::string_view name) {
+          if(!statistics_) {
+            return;
+          }
+          size_t index = static_cast<size_t>(statementId);
+          if(index >= registrySeries_.size()) {
+            registrySeries_.resize(StatementRegistry::instance()->size(), nullptr);
+          }
+          Statistics::Series *&series = registrySeries_[index];
+          if(series == nullptr) {
+            series = Statistics::instance()->statementSeries(base_->hostIndex_, name);
+          }
+          request.statementSeries = series;
+          request.statementSeries->increment(Statistics::Counter::Requests);
+        }
+
+        // everything libpq buffered is on the socket, requests not yet counted as sent are the newest ones
+        void recordSent() {
+          std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+          for(std::deque<Request>::reverse_iterator i = requests_.rbegin(); i != requests_.rend() && !i->isSent; ++i) {
+            i->isSent = true;
+            statistics_->record(Statistics::Stage::Send, now - i->sendTime);
+            if(i->statementSeries) {
+              i->statementSeries->record(Statistics::Stage::Send, now - i->sendTime);
             }
           }
         }
 
+        static std::vector<Oid> parameterTypes(const PGresult *r) {
+          int n = PQnparams(r);
+          std::vector<Oid> oids;
+          oids.reserve(n);
+          for(int i = 0; i < n; i++) {
+            oids.push_back(PQparamtype(r, i));
+          }
+          return oids;
+        }
+
+        static void completeRequest(Request &request, const AsyncObjectPtr<Connection> &base) {
+          switch(request.type) {
+            case Request::Type::Execute:
+              if(request.handler) {
+                request.handler(request.error, std::move(request.result), base);
+              }
+              break;
+            case Request::Type::Prepare:
+              if(request.prepareHandler) {
+                request.prepareHandler(request.error, base);
+              }
+              break;
+            case Request::Type::Multi:
+              if(request.multiHandler) {
+                request.multiHandler(request.error, std::move(request.results), base);
+              }
+              break;
+          }
+        }
+
+        // exclusive requests and batches switch the pipeline mode of an idle connection, it is put back afterwards
+        void restorePipelineMode() {
+          bool isPipeline = PQpipelineStatus(handle_) != PQ_PIPELINE_OFF;
+          if(maxPipelineDepth_ > 1 && !isPipeline) {
+            PQenterPipelineMode(handle_);
+          } else if(maxPipelineDepth_ <= 1 && isPipeline) {
+            PQexitPipelineMode(handle_);
+          }
+        }
+
         static void pollConnectionCallback(uv_poll_t *handle, int status, int events) {
           ConnectionImpl *_this = reinterpret_cast<ConnectionImpl *>(uv_handle_get_data(reinterpret_cast<uv_handle_t *>(handle)));
           if(_this == nullptr) {
             return;
           }
           if(status < 0) {
-            if(status == -9) {
-              _this->reconnect(MAKE_ERROR("Unable to connect to postgresql server. %s", PQerrorMessage(_this->handle_)));
-            } else {
-              _this->reconnect(MAKE_ERROR("Bad status %d", status));
-            }
+            Error error = status == -9 ? MAKE_ERROR("Unable to connect to postgresql server. %s", PQerrorMessage(_this->handle_)) : MAKE_ERROR("Bad status %d", status);
+            _this->state_ == State::Connecting ? _this->failAttempt(error) : _this->reconnect(error);
             return;
           }
           if((events & ~(UV_READABLE | UV_WRITABLE)) != 0) {
@@ -254,7 +568,8 @@
 
           Error error = _this->pollConnection();
           if(error.isFail()) {
-            _this->reconnect(error);
+            // errors of the connected handler are not a fault of the address
+            _this->state_ == State::Connecting ? _this->failAttempt(error) : _this->reconnect(error);
             return;
           }
         }
@@ -276,9 +591,8 @@
         }
 
         Error pollCommands(int events) {
-          int eventmask = eventmask_;
-
           if(events & UV_WRITABLE) {
+            int eventmask = eventmask_;
             int rc = PQflush(handle_);
             if(rc == 0) {
               if(0) { // maybe_send_req()) {
@@ -291,40 +605,264 @@
               }
             }
 
+            if(rc == 0 && statistics_) {
+              recordSent();
+            }
             if(rc == 1) {
               eventmask |= UV_READABLE | UV_WRITABLE;
             } else if(rc != 0 && rc == -1) {
               return MAKE_ERROR("Unable to flush data to server. %s", PQerrorMessage(handle_));
             }
+            Error error = updatePollEventmask(eventmask);
+            if(error.isFail()) {
+              return error;
+            }
+            if(!requests_.empty() && requests_.front().isCopyIn) {
+              error = pumpCopyIn();
+              if(error.isFail()) {
+                return error;
+              }
+            }
           }
 
           if(events & UV_READABLE) {
             if(!PQconsumeInput(handle_)) {
               return MAKE_ERROR("Unable to receive data from server. %s", PQerrorMessage(handle_));
             }
+            Error error = processResults();
+            if(error.isFail() || !base_) {
+              return error;
+            }
+            dispatchNotifications();
+          }
+
+          return Error::Success;
+        }
 
-            if(!PQisBusy(handle_)) {
-              Recordset result(PQgetResult(handle_));
+        // results arrive in the order the requests were sent. Without pipeline a request ends with the NULL result,
+        // in pipeline mode every request is followed by its own sync point and ends with PGRES_PIPELINE_SYNC
+        Error processResults() {
+          isProcessingResults_ = true;
+          Error error = processResultsImpl();
+          isProcessingResults_ = false;
+          return error;
+        }
 
-              ExecStatusType res = PQresultStatus(result.handle());
-              if(res != PGRES_TUPLES_OK && res != PGRES_COMMAND_OK) {
-                while(PQgetResult(handle_)) {}
-                finishRequest(MAKE_ERROR("Unable to execute %s", PQerrorMessage(handle_)), std::move(result));
-                return Error::Success;
+        Error processResultsImpl() {
+          while(!isReadingPaused_ && !requests_.empty() && !requests_.front().isCopyIn) {
+            if(requests_.front().isCopyOut) {
+              Error error = pullCopyOut();
+              if(error.isFail() || !base_) {
+                return error;
+              }
+              if(requests_.front().isCopyOut) {
+                break;
               }
-              // TODO: handle more results
-              if(PQgetResult(handle_) != nullptr) {
-                return MAKE_ERROR("handling of more results is not supported");
+              continue;
+            }
+            if(PQisBusy(handle_)) {
+              break;
+            }
+            PGresult *r = PQgetResult(handle_);
+            Request &request = requests_.front();
+            if(statistics_ && !request.isFirstResultReceived && r != nullptr) {
+              recordFirstResult(request);
+            }
+            if(r == nullptr) {
+              if(PQpipelineStatus(handle_) == PQ_PIPELINE_OFF) {
+                finishRequest();
+                if(!base_) {
+                  return Error::Success;
+                }
               }
+              continue;
+            }
 
-              finishRequest(Error::Success, std::move(result));
+            Recordset result(r);
+            ExecStatusType status = PQresultStatus(r);
+            switch(status) {
+              case PGRES_EMPTY_QUERY:
+              case PGRES_COMMAND_OK:
+              case PGRES_TUPLES_OK:
+                if(request.prepareResults > 0) {
+                  request.prepareResults--;
+                  if(request.prepareResults == 0 && request.isDescribing) {
+                    StatementRegistry::instance()->setParameterTypes(request.statementId, parameterTypes(r));
+                  }
+                  break;
+                }
+                if(request.type == Request::Type::Multi) {
+                  request.results.push_back(std::move(result));
+                  break;
+                }
+                if(request.hasResult && request.type != Request::Type::Prepare) {
+                  return MAKE_ERROR("handling of more results is not supported");
+                }
+                request.result = std::move(result);
+                request.hasResult = true;
+                break;
+              case PGRES_NONFATAL_ERROR:
+              case PGRES_BAD_RESPONSE:
+              case PGRES_FATAL_ERROR:
+                if(request.prepareResults > 0) {
+                  // lazy prepare failed, it is sent again on the next use
+                  preparedStatements_[static_cast<size_t>(request.statementId)] = false;
+                  request.prepareResults = 0;
+                }
+                // an error of the copy handler comes first, the server only reports the copy aborted by it
+                if(request.error.isSuccess()) {
+                  request.error = MAKE_ERROR("Unable to execute %s", PQresultErrorMessage(r));
+                }
+                // the failed result of a batch query is kept in its place for the SQLSTATE and the other error fields
+                if(request.type == Request::Type::Multi) {
+                  request.results.push_back(std::move(result));
+                  break;
+                }
+                request.result = std::move(result);
+                request.hasResult = true;
+                break;
+              case PGRES_PIPELINE_ABORTED:
+                // queries after the failed one are skipped, the error is the one of the failed query
+                if(request.error.isSuccess()) {
+                  request.error = MAKE_ERROR("Unable to execute. Pipeline aborted by previous error");
+                }
+                break;
+              case PGRES_PIPELINE_SYNC:
+                finishRequest();
+                if(!base_) {
+                  return Error::Success;
+                }
+                break;
+              case PGRES_SINGLE_TUPLE:
+#ifdef LIBPQ_HAS_CHUNK_MODE
+              case PGRES_TUPLES_CHUNK:
+#endif
+                if(!request.rowHandler) {
+                  return MAKE_ERROR("Unexpected result %s", PQresStatus(status));
+                }
+                if(request.isAbandoned) {
+                  break;
+                }
+                request.rowHandler(std::move(result), base_);
+                if(!base_) {
+                  return Error::Success;
+                }
+                break;
+              case PGRES_COPY_IN: {
+                if(!request.copyInHandler) {
+                  return MAKE_ERROR("Unexpected result %s", PQresStatus(status));
+                }
+                request.isCopyIn = true;
+                Error error = pumpCopyIn();
+                if(error.isFail() || !base_) {
+                  return error;
+                }
+                break;
+              }
+              case PGRES_COPY_OUT:
+                if(!request.copyOutHandler) {
+                  return MAKE_ERROR("Unexpected result %s", PQresStatus(status));
+                }
+                request.isCopyOut = true;
+                break;
+              case PGRES_COPY_BOTH:
+                return MAKE_ERROR("Unsupported result %s", PQresStatus(status));
+            }
+          }
+          return Error::Success;
+        }
 
+        // every row is passed straight from the libpq buffer, the final result follows the end of copy
+        Error pullCopyOut() {
+          Request &request = requests_.front();
+          while(!isReadingPaused_) {
+            char *buffer = nullptr;
+            int rc = PQgetCopyData(handle_, &buffer, 1);
+            if(rc > 0) {
+              if(!request.isAbandoned) {
+                request.copyOutHandler(std::string_view(buffer, rc), base_);
+              }
+              PQfreemem(buffer);
+              if(!base_) {
+                return Error::Success;
+              }
+            } else if(rc == 0) {
+              return Error::Success;
+            } else if(rc == -1) {
+              request.isCopyOut = false;
+              return Error::Success;
             } else {
-              /* noop */
+              return MAKE_ERROR("Unable to receive copy data. %s", PQerrorMessage(handle_));
+            }
+          }
+          return Error::Success;
+        }
+
+        // sends copy data while the socket accepts it, the rest goes on the next writable event
+        Error pumpCopyIn() {
+          Request &request = requests_.front();
+          while(!request.isCopyInFinished) {
+            if(request.isAbandoned) {
+              request.error = MAKE_ERROR("Copy abandoned");
+              request.isCopyInFinished = true;
+              break;
+            }
+            if(request.copyData.empty()) {
+              Error error = request.copyInHandler(request.copyData);
+              if(!base_) {
+                return Error::Success;
+              }
+              if(error.isFail()) {
+                request.error = error;
+                request.isCopyInFinished = true;
+              } else if(request.copyData.empty()) {
+                request.isCopyInFinished = true;
+              }
+              continue;
+            }
+            int rc = PQputCopyData(handle_, request.copyData.data(), static_cast<int>(request.copyData.size()));
+            if(rc == 0) {
+              return updatePollEventmask(eventmask_ | UV_WRITABLE);
+            }
+            if(rc == -1) {
+              // the server has already finished the copy, its error comes with the next result
+              request.error = MAKE_ERROR("Unable to send copy data. %s", PQerrorMessage(handle_));
+              request.isCopyIn = false;
+              return isProcessingResults_ ? Error::Success : processResults();
+            }
+            request.copyData = {};
+            rc = PQflush(handle_);
+            if(rc == -1) {
+              return MAKE_ERROR("Unable to flush data to server. %s", PQerrorMessage(handle_));
+            }
+            if(rc == 1) {
+              return updatePollEventmask(eventmask_ | UV_WRITABLE);
             }
           }
 
-          return updatePollEventmask(eventmask);
+          int rc = PQputCopyEnd(handle_, request.error.isFail() ? "Copy aborted by client" : nullptr);
+          if(rc == 0) {
+            return updatePollEventmask(eventmask_ | UV_WRITABLE);
+          }
+          if(rc == -1) {
+            return MAKE_ERROR("Unable to finish copy. %s", PQerrorMessage(handle_));
+          }
+          request.isCopyIn = false;
+          return flush();
+        }
+
+        Error flush() {
+          int rc = PQflush(handle_);
+          if(rc == -1) {
+            return MAKE_ERROR("Unable to flush data to server. %s", PQerrorMessage(handle_));
+          }
+          if(rc == 1) {
+            return updatePollEventmask(eventmask_ | UV_WRITABLE);
+          }
+          if(statistics_) {
+            recordSent();
+          }
+          return Error::Success;
         }
 
         Error pollConnection() {
@@ -333,7 +871,7 @@
             case State::Connecting:
               rc = PQconnectPoll(handle_);
               break;
-            case State::Disconnecting:
+            case State::Resetting:
               rc = PQresetPoll(handle_);
               break;
             default:
@@ -357,6 +895,28 @@
             }
             case PGRES_POLLING_OK: {
               connectTimer_->stop();
+              attemptTimer_->stop();
+              if(base_) {
+                base_->reconnectAttempt_ = 0;
+              }
+              if(base_ && addressIndex_ > 0) {
+                DnsCache::instance()->setConnected(base_->options().hosts()[base_->hostIndex_], addresses_[addressIndex_ - 1]);
+              }
+              if(statistics_) {
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                statistics_->record(Statistics::Stage::Connect, now - stageStart_);
+                statistics_->increment(Statistics::Counter::Connects);
+                if(base_ && base_->disconnectTime_ != std::chrono::steady_clock::time_point()) {
+                  statistics_->record(Statistics::Stage::Reconnect, now - base_->disconnectTime_);
+                  base_->disconnectTime_ = {};
+                }
+              }
+              if(PQsetnonblocking(handle_, 1) != 0) {
+                return MAKE_ERROR("Unable to set nonblocking mode. %s", PQerrorMessage(handle_));
+              }
+              if(maxPipelineDepth_ > 1 && PQenterPipelineMode(handle_) != 1) {
+                return MAKE_ERROR("Unable to enter pipeline mode. %s", PQerrorMessage(handle_));
+              }
               state_ = State::Connected;
               eventmask_ = events = UV_WRITABLE | UV_READABLE;
               if(base_) {
@@ -378,56 +938,182 @@
           }
           if(PQstatus(handle_) == CONNECTION_OK) {
             if(callConnectedHandler) {
-              if(base_->connectedHandler_) {
-                Error error = base_->connectedHandler_();
-                if(error.isFail()) {
-                  return error;
-                }
+              role_ = ServerRole::Unknown;
+              if(serverRole() == ServerRole::Unknown) {
+                return detectServerRole();
               }
+              return notifyConnected();
             }
           }
           return Error::Success;
         }
 
-        State state() const {
-          return state_;
-        }
-
-        Error updatePollEventmask(int eventmask) {
-          if(eventmask != eventmask_) {
-            int rc = uv_poll_start(pollHandle_, eventmask, pollCommandsCallback);
-            if(rc != 0) {
-              return MAKE_ERROR("Unable to start poll. %s\n", uv_strerror(rc));
+        void dispatchNotifications() {
+          while(PGnotify *notify = PQnotifies(handle_)) {
+            std::unordered_map<std::string, NotificationHandler>::iterator i = base_->subscriptions_.find(notify->relname);
+            if(i != base_->subscriptions_.end() && i->second) {
+              // a copy, the handler may unsubscribe itself
+              NotificationHandler handler = i->second;
+              handler(notify->relname, notify->extra ? notify->extra : "", base_);
+            }
+            PQfreemem(notify);
+            if(!base_) {
+              return;
             }
-            eventmask_ = eventmask;
           }
-          return Error::Success;
         }
 
-        PGconn *handle() const {
-          return handle_;
+        void listen(const char *command, const std::string &channel) {
+          if(state_ != State::Connected) {
+            return;
+          }
+          appendListen(command, channel);
+          sendPendingListen();
         }
 
-        bool isBusy() const {
-          return isExecuting_;
+        void appendListen(const char *command, const std::string &channel) {
+          char *identifier = PQescapeIdentifier(handle_, channel.c_str(), channel.size());
+          if(identifier == nullptr) {
+            return;
+          }
+          pendingListen_.push_back(std::string(command).append(" ").append(identifier));
+          PQfreemem(identifier);
         }
 
-        Error execute(const char *query, const QueryData *queryData, Recordset *resultPtr) {
-          if(state_ != ConnectionImpl::State::Connected) {
-            return MAKE_ERROR("Connection is currently disconnected");
+        // commands are sent together as one pipelined request that takes no place of the pipeline depth, an idle
+        // connection enters pipeline mode for it. Without pipeline they wait until the running request completes.
+        // A failed LISTEN is sent again on the next connect
+        void sendPendingListen() {
+          if(pendingListen_.empty() || state_ != State::Connected || base_->isCancelPending_) {
+            return;
           }
-          if(isBusy()) {
-            return MAKE_ERROR("Connection is busy");
+          if(PQpipelineStatus(handle_) == PQ_PIPELINE_OFF && (!requests_.empty() || PQenterPipelineMode(handle_) != 1)) {
+            return;
           }
-          PGresult *r;
-          if(queryData == nullptr) {
-            r = PQexecParams(handle_, query, 0, nullptr, nullptr, nullptr, nullptr, 1);
-          } else {
-            r = PQexecParams(
-                handle_, query, queryData->values().size(), queryData->types().data(), queryData->values().data(), queryData->lengths().data(), queryData->formats().data(), 1);
+          std::vector<std::string> commands = std::move(pendingListen_);
+          pendingListen_.clear();
+          size_t sent = 0;
+          for(const std::string &command : commands) {
+            if(PQsendQueryParams(handle_, command.c_str(), 0, nullptr, nullptr, nullptr, nullptr, 0) == 0) {
+              break;
+            }
+            sent++;
           }
-          if(r == nullptr) {
-            return MAKE_ERROR("Unable to create query");
+          if(sent == 0) {
+            if(requests_.empty()) {
+              restorePipelineMode();
+            }
+            return;
+          }
+          Request &request = pushRequest(InvalidRequestId, {});
+          request.type = Request::Type::Multi;
+          request.isInternal = true;
+          internalRequests_++;
+          finishSend();
+        }
+
+        Error notifyConnected() {
+          if(base_->connectedHandler_) {
+            Error error = base_->connectedHandler_();
+            if(error.isFail() || !base_) {
+              return error;
+            }
+          }
+          // subscriptions are restored after the handler, which may prepare statements first
+          pendingListen_.clear();
+          for(const std::pair<const std::string, NotificationHandler> &subscription : base_->subscriptions_) {
+            appendListen("LISTEN", subscription.first);
+          }
+          sendPendingListen();
+          return Error::Success;
+        }
+
+        // servers before 14 do not report in_hot_standby, the connected handler waits for pg_is_in_recovery()
+        Error detectServerRole() {
+          executeQuery(
+              "SELECT pg_is_in_recovery()",
+              nullptr,
+              [this](const Error &error, Recordset &&result, const AsyncObjectPtr<Connection> &) {
+                if(!base_ || state_ != State::Connected) {
+                  return;
+                }
+                Error e = error;
+                if(e.isSuccess()) {
+                  PGresult *r = result.handle();
+                  if(r == nullptr || PQntuples(r) != 1 || PQgetisnull(r, 0, 0)) {
+                    e = MAKE_ERROR("Unable to detect server role");
+                  } else {
+                    // binary bool or text 't'
+                    char value = PQgetvalue(r, 0, 0)[0];
+                    role_ = value == 1 || value == 't' ? ServerRole::Standby : ServerRole::Primary;
+                    e = notifyConnected();
+                  }
+                }
+                if(e.isFail()) {
+                  reconnect(e);
+                }
+              },
+              InvalidRequestId);
+          return Error::Success;
+        }
+
+        // in_hot_standby is reported again when a standby is promoted
+        ServerRole serverRole() const {
+          if(state_ != State::Connected) {
+            return ServerRole::Unknown;
+          }
+          const char *inHotStandby = PQparameterStatus(handle_, "in_hot_standby");
+          if(inHotStandby != nullptr) {
+            return std::string_view(inHotStandby) == "on" ? ServerRole::Standby : ServerRole::Primary;
+          }
+          return role_;
+        }
+
+        State state() const {
+          return state_;
+        }
+
+        Error updatePollEventmask(int eventmask) {
+          if(eventmask != eventmask_) {
+            int rc = uv_poll_start(pollHandle_, eventmask, pollCommandsCallback);
+            if(rc != 0) {
+              return MAKE_ERROR("Unable to start poll. %s\n", uv_strerror(rc));
+            }
+            eventmask_ = eventmask;
+          }
+          return Error::Success;
+        }
+
+        PGconn *handle() const {
+          return handle_;
+        }
+
+        // a pending cancel holds new requests back until it is delivered. LISTEN requests are not counted
+        bool isBusy() const {
+          return base_->isCancelPending_ || requests_.size() - internalRequests_ >= (PQpipelineStatus(handle_) == PQ_PIPELINE_ON ? maxPipelineDepth_ : 1);
+        }
+
+        size_t pendingRequestCount() const {
+          return requests_.size();
+        }
+
+        Error execute(const char *query, const QueryData *queryData, Recordset *resultPtr) {
+          if(state_ != ConnectionImpl::State::Connected) {
+            return MAKE_ERROR("Connection is currently disconnected");
+          }
+          if(!requests_.empty()) {
+            return MAKE_ERROR("Connection is busy");
+          }
+          PipelineSuspender pipelineSuspender(handle_);
+          PGresult *r;
+          if(queryData == nullptr) {
+            r = PQexecParams(handle_, query, 0, nullptr, nullptr, nullptr, nullptr, 1);
+          } else {
+            r = PQexecParams(
+                handle_, query, queryData->values().size(), queryData->types().data(), queryData->values().data(), queryData->lengths().data(), queryData->formats().data(), 1);
+          }
+          if(r == nullptr) {
+            return MAKE_ERROR("Unable to create query");
           }
           Recordset result(r);
           ExecStatusType status = PQresultStatus(r);
@@ -463,9 +1149,10 @@
           if(state_ != ConnectionImpl::State::Connected) {
             return MAKE_ERROR("Connection is currently disconnected");
           }
-          if(isBusy()) {
+          if(!requests_.empty()) {
             return MAKE_ERROR("Connection is busy");
           }
+          PipelineSuspender pipelineSuspender(handle_);
           PGresult *r;
           if(types) {
             r = PQprepare(handle_, name, query, types->size(), types->data());
@@ -512,7 +1199,7 @@
           return Error::Success;
         }
 
-        void execute(const char *preparedName, const QueryData *queryData, ExecuteHandler &&handler, RequestId requestId) {
+        void execute(const char *preparedName, const QueryData *queryData, ExecuteHandler &&handler, RequestId requestId, std::chrono::milliseconds timeout) {
           if(state_ != ConnectionImpl::State::Connected) {
             handler(MAKE_ERROR("Connection is currently disconnected"), {}, base_);
             return;
@@ -551,18 +1238,508 @@
             handler(error, {}, base_);
             return;
           }
+          Request &request = pushRequest(requestId, timeout);
+          request.handler = std::move(handler);
+          setStatement(request, preparedName);
+          finishSend();
+        }
 
-          executeHandler_ = std::move(handler);
-          requestId_ = requestId;
-          isExecuting_ = true;
-          return;
+        // the statement is prepared (and described once per process) in the same round-trip as its first execute on this connection
+        void execute(StatementId statementId, const QueryData *queryData, ExecuteHandler &&handler, RequestId requestId, std::chrono::milliseconds timeout) {
+          if(state_ != ConnectionImpl::State::Connected) {
+            handler(MAKE_ERROR("Connection is currently disconnected"), {}, base_);
+            return;
+          }
+          if(isBusy()) {
+            handler(MAKE_ERROR("Connection is busy"), {}, base_);
+            return;
+          }
+          StatementRegistry *registry = StatementRegistry::instance();
+          size_t index = static_cast<size_t>(statementId);
+          if(index >= registry->size()) {
+            handler(MAKE_ERROR("Unknown statement %d", index), {}, base_);
+            return;
+          }
+          const StatementRegistry::Statement &statement = registry->statement(statementId);
+
+          if(queryData && base_->options().isCheckQueryParameters() && statement.isDescribed.load(std::memory_order_acquire)) {
+            const std::vector<Oid> &oids = statement.parameterTypes;
+            if(queryData->count() != oids.size()) {
+              handler(MAKE_ERROR("Wrong parameter count."), {}, base_);
+              return;
+            }
+            for(size_t i = 0; i < oids.size(); i++) {
+              if(queryData->types()[i] != 0 && oids[i] != static_cast<Oid>(queryData->types()[i])) {
+                handler(MAKE_ERROR("Wrong parameter type %d for parameter %d. Must be %d.", queryData->types()[i], i, oids[i]), {}, base_);
+                return;
+              }
+            }
+          }
+
+          if(queryData) {
+            ParameterView parameters = {static_cast<int>(queryData->values().size()), queryData->values().data(), queryData->lengths().data(), queryData->formats().data()};
+            send(statementId, parameters, std::move(handler), requestId, timeout);
+          } else {
+            send(statementId, {0, nullptr, nullptr, nullptr}, std::move(handler), requestId, timeout);
+          }
+        }
+
+        void send(StatementId statementId, const ParameterView &parameters, ExecuteHandler &&handler, RequestId requestId, std::chrono::milliseconds timeout) {
+          if(state_ != ConnectionImpl::State::Connected) {
+            handler(MAKE_ERROR("Connection is currently disconnected"), {}, base_);
+            return;
+          }
+          if(isBusy()) {
+            handler(MAKE_ERROR("Connection is busy"), {}, base_);
+            return;
+          }
+          StatementRegistry *registry = StatementRegistry::instance();
+          size_t index = static_cast<size_t>(statementId);
+          const StatementRegistry::Statement &statement = registry->statement(statementId);
+          bool isDescribed = statement.isDescribed.load(std::memory_order_acquire);
+
+          if(index >= preparedStatements_.size()) {
+            preparedStatements_.resize(registry->size(), false);
+          }
+          bool isPrepareNeeded = !preparedStatements_[index];
+          if(isPrepareNeeded) {
+            bool isPipelineEntered = false;
+            if(PQpipelineStatus(handle_) == PQ_PIPELINE_OFF) {
+              if(PQenterPipelineMode(handle_) != 1) {
+                handler(MAKE_ERROR("Unable to enter pipeline mode. %s", PQerrorMessage(handle_)), {}, base_);
+                return;
+              }
+              isPipelineEntered = true;
+            }
+            if(PQsendPrepare(handle_, statement.name.c_str(), statement.query.c_str(), statement.types.size(), statement.hasTypes ? statement.types.data() : nullptr) == 0) {
+              Error error = MAKE_ERROR("Unable to prepare query. %s", PQerrorMessage(handle_));
+              // nothing is queued, the connection is left as it was
+              if(isPipelineEntered) {
+                PQexitPipelineMode(handle_);
+              }
+              handler(error, {}, base_);
+              return;
+            }
+            preparedStatements_[index] = true;
+            if(!isDescribed && PQsendDescribePrepared(handle_, statement.name.c_str()) == 0) {
+              // the prepare is queued, its result is taken by a request carrying the error
+              Request &request = pushRequest(requestId, timeout);
+              request.handler = std::move(handler);
+              request.statementId = statementId;
+              setStatement(request, statementId, statement.name);
+              request.prepareResults = 1;
+              request.error = MAKE_ERROR("Unable to describe prepared statement. %s", PQerrorMessage(handle_));
+              finishSend();
+              return;
+            }
+          }
+
+          int rc = PQsendQueryPrepared(handle_, statement.name.c_str(), parameters.count, parameters.values, parameters.lengths, parameters.formats, 1);
+          if(rc == 0 && !isPrepareNeeded) {
+            handler(MAKE_ERROR("Unable to execute query. %s", PQerrorMessage(handle_)), {}, base_);
+            return;
+          }
+          Request &request = pushRequest(requestId, timeout);
+          request.handler = std::move(handler);
+          request.statementId = statementId;
+          setStatement(request, statementId, statement.name);
+          if(isPrepareNeeded) {
+            request.isDescribing = !isDescribed;
+            request.prepareResults = isDescribed ? 1 : 2;
+            if(rc == 0) {
+              request.error = MAKE_ERROR("Unable to execute query. %s", PQerrorMessage(handle_));
+            }
+          }
+          finishSend();
+        }
+
+        void executeQuery(const char *query, const QueryData *queryData, ExecuteHandler &&handler, RequestId requestId) {
+          if(state_ != ConnectionImpl::State::Connected) {
+            handler(MAKE_ERROR("Connection is currently disconnected"), {}, base_);
+            return;
+          }
+          if(isBusy()) {
+            handler(MAKE_ERROR("Connection is busy"), {}, base_);
+            return;
+          }
+
+          int rc;
+          if(queryData) {
+            rc = PQsendQueryParams(
+                handle_, query, queryData->values().size(), queryData->types().data(), queryData->values().data(), queryData->lengths().data(), queryData->formats().data(), 1);
+          } else {
+            rc = PQsendQueryParams(handle_, query, 0, nullptr, nullptr, nullptr, nullptr, 1);
+          }
+          if(rc == 0) {
+            Error error = MAKE_ERROR("Unable to execute query. %s", PQerrorMessage(handle_));
+            handler(error, {}, base_);
+            return;
+          }
+          Request &request = pushRequest(requestId, base_->requestTimeout_);
+          request.handler = std::move(handler);
+          finishSend();
+        }
+
+        void prepare(const char *name, const char *query, const std::vector<unsigned int> *types, PrepareHandler &&handler) {
+          if(state_ != ConnectionImpl::State::Connected) {
+            handler(MAKE_ERROR("Connection is currently disconnected"), base_);
+            return;
+          }
+          if(isBusy()) {
+            handler(MAKE_ERROR("Connection is busy"), base_);
+            return;
+          }
+
+          int rc;
+          if(types) {
+            rc = PQsendPrepare(handle_, name, query, types->size(), types->data());
+          } else {
+            rc = PQsendPrepare(handle_, name, query, 0, nullptr);
+          }
+          if(rc == 0) {
+            Error error = MAKE_ERROR("Unable to prepare query. %s", PQerrorMessage(handle_));
+            handler(error, base_);
+            return;
+          }
+          bool isPipeline = PQpipelineStatus(handle_) != PQ_PIPELINE_OFF;
+          Request &request = pushRequest(InvalidRequestId, base_->requestTimeout_);
+          request.type = Request::Type::Prepare;
+          request.prepareHandler = std::move(handler);
+          request.name = name;
+          request.isDescribePending = !isPipeline;
+          // the prepare is queued, its result is still taken by this request
+          if(isPipeline && PQsendDescribePrepared(handle_, name) == 0) {
+            request.error = MAKE_ERROR("Unable to describe prepared statement. %s", PQerrorMessage(handle_));
+          }
+          finishSend();
+        }
+
+        void executeStreaming(const char *preparedName, const QueryData *queryData, RowHandler &&rowHandler, ExecuteHandler &&handler, RequestId requestId, size_t chunkSize) {
+          if(state_ != ConnectionImpl::State::Connected) {
+            handler(MAKE_ERROR("Connection is currently disconnected"), {}, base_);
+            return;
+          }
+          Error error = prepareExclusiveRequest();
+          if(error.isFail()) {
+            handler(error, {}, base_);
+            return;
+          }
+
+          int rc;
+          if(queryData) {
+            rc = PQsendQueryPrepared(handle_, preparedName, queryData->values().size(), queryData->values().data(), queryData->lengths().data(), queryData->formats().data(), 1);
+          } else {
+            rc = PQsendQueryPrepared(handle_, preparedName, 0, nullptr, nullptr, nullptr, 1);
+          }
+          if(rc != 0) {
+#ifdef LIBPQ_HAS_CHUNK_MODE
+            rc = chunkSize > 1 ? PQsetChunkedRowsMode(handle_, static_cast<int>(chunkSize)) : PQsetSingleRowMode(handle_);
+#else
+            std::ignore = chunkSize;
+            rc = PQsetSingleRowMode(handle_);
+#endif
+          }
+          if(rc == 0) {
+            Error error = MAKE_ERROR("Unable to execute query. %s", PQerrorMessage(handle_));
+            handler(error, {}, base_);
+            return;
+          }
+          Request &request = pushRequest(requestId, base_->requestTimeout_);
+          request.handler = std::move(handler);
+          request.rowHandler = std::move(rowHandler);
+          setStatement(request, preparedName);
+          finishSend();
+        }
+
+        void copyFrom(const char *query, CopyInHandler &&copyInHandler, ExecuteHandler &&handler, RequestId requestId) {
+          if(state_ != ConnectionImpl::State::Connected) {
+            handler(MAKE_ERROR("Connection is currently disconnected"), {}, base_);
+            return;
+          }
+          Error error = prepareExclusiveRequest();
+          if(error.isFail()) {
+            handler(error, {}, base_);
+            return;
+          }
+          if(PQsendQueryParams(handle_, query, 0, nullptr, nullptr, nullptr, nullptr, 1) == 0) {
+            handler(MAKE_ERROR("Unable to execute query. %s", PQerrorMessage(handle_)), {}, base_);
+            return;
+          }
+          Request &request = pushRequest(requestId, base_->requestTimeout_);
+          request.handler = std::move(handler);
+          request.copyInHandler = std::move(copyInHandler);
+          finishSend();
+        }
+
+        // statements of the query are executed with the simple protocol, so the results are in text format
+        void executeMulti(const char *query, MultiExecuteHandler &&handler, RequestId requestId) {
+          if(state_ != ConnectionImpl::State::Connected) {
+            handler(MAKE_ERROR("Connection is currently disconnected"), {}, base_);
+            return;
+          }
+          Error error = prepareExclusiveRequest();
+          if(error.isFail()) {
+            handler(error, {}, base_);
+            return;
+          }
+          if(PQsendQuery(handle_, query) == 0) {
+            handler(MAKE_ERROR("Unable to execute query. %s", PQerrorMessage(handle_)), {}, base_);
+            return;
+          }
+          Request &request = pushRequest(requestId, base_->requestTimeout_);
+          request.type = Request::Type::Multi;
+          request.multiHandler = std::move(handler);
+          finishSend();
+        }
+
+        // all queries of the batch share one sync point, an idle connection enters pipeline mode for it
+        void executeBatch(const std::vector<BatchQuery> &queries, MultiExecuteHandler &&handler, RequestId requestId) {
+          if(state_ != ConnectionImpl::State::Connected) {
+            handler(MAKE_ERROR("Connection is currently disconnected"), {}, base_);
+            return;
+          }
+          if(isBusy()) {
+            handler(MAKE_ERROR("Connection is busy"), {}, base_);
+            return;
+          }
+          if(PQpipelineStatus(handle_) == PQ_PIPELINE_OFF && PQenterPipelineMode(handle_) != 1) {
+            handler(MAKE_ERROR("Unable to enter pipeline mode. %s", PQerrorMessage(handle_)), {}, base_);
+            return;
+          }
+
+          Error error = Error::Success;
+          size_t sent = 0;
+          for(const BatchQuery &query : queries) {
+            int rc;
+            if(query.queryData) {
+              rc = PQsendQueryPrepared(
+                  handle_, query.preparedName, query.queryData->values().size(), query.queryData->values().data(), query.queryData->lengths().data(), query.queryData->formats().data(), 1);
+            } else {
+              rc = PQsendQueryPrepared(handle_, query.preparedName, 0, nullptr, nullptr, nullptr, 1);
+            }
+            if(rc == 0) {
+              error = MAKE_ERROR("Unable to execute query. %s", PQerrorMessage(handle_));
+              break;
+            }
+            sent++;
+          }
+          if(sent == 0) {
+            if(requests_.empty()) {
+              restorePipelineMode();
+            }
+            handler(error.isFail() ? error : MAKE_ERROR("Batch is empty"), {}, base_);
+            return;
+          }
+          Request &request = pushRequest(requestId, base_->requestTimeout_);
+          request.type = Request::Type::Multi;
+          request.multiHandler = std::move(handler);
+          request.error = error;
+          finishSend();
+        }
+
+        void copyTo(const char *query, CopyOutHandler &&copyOutHandler, ExecuteHandler &&handler, RequestId requestId) {
+          if(state_ != ConnectionImpl::State::Connected) {
+            handler(MAKE_ERROR("Connection is currently disconnected"), {}, base_);
+            return;
+          }
+          Error error = prepareExclusiveRequest();
+          if(error.isFail()) {
+            handler(error, {}, base_);
+            return;
+          }
+          if(PQsendQueryParams(handle_, query, 0, nullptr, nullptr, nullptr, nullptr, 1) == 0) {
+            handler(MAKE_ERROR("Unable to execute query. %s", PQerrorMessage(handle_)), {}, base_);
+            return;
+          }
+          Request &request = pushRequest(requestId, base_->requestTimeout_);
+          request.handler = std::move(handler);
+          request.copyOutHandler = std::move(copyOutHandler);
+          finishSend();
+        }
+
+        // single row mode and copy can't be combined with other queries in flight, so the pipeline is left while the connection is idle
+        Error prepareExclusiveRequest() {
+          if(!requests_.empty() || base_->isCancelPending_) {
+            return MAKE_ERROR("Connection is busy");
+          }
+          if(PQpipelineStatus(handle_) != PQ_PIPELINE_OFF && PQexitPipelineMode(handle_) != 1) {
+            return MAKE_ERROR("Unable to exit pipeline mode. %s", PQerrorMessage(handle_));
+          }
+          return Error::Success;
+        }
+
+        void pauseReading() {
+          if(!isReadingPaused_ && handle_) {
+            isReadingPaused_ = true;
+            Error error = updatePollEventmask(eventmask_ & ~UV_READABLE);
+            if(error.isFail()) {
+              reconnect(error);
+            }
+          }
+        }
+
+        void resumeReading() {
+          if(!isReadingPaused_ || !handle_) {
+            return;
+          }
+          isReadingPaused_ = false;
+          Error error = updatePollEventmask(eventmask_ | UV_READABLE);
+          // results already buffered by libpq won't trigger the poll again
+          if(error.isSuccess() && !isProcessingResults_) {
+            error = processResults();
+          }
+          if(error.isFail()) {
+            reconnect(error);
+          }
+        }
+
+        Request &pushRequest(RequestId requestId, std::chrono::milliseconds timeout) {
+          Request &request = requests_.emplace_back();
+          request.id = requestId;
+          if(statistics_) {
+            request.sendTime = std::chrono::steady_clock::now();
+            statistics_->increment(Statistics::Counter::Requests);
+          }
+          if(timeout.count() > 0) {
+            request.deadline = std::chrono::steady_clock::now() + timeout;
+            if(requestTimerDeadline_ == std::chrono::steady_clock::time_point() || request.deadline < requestTimerDeadline_) {
+              startRequestTimer(request.deadline);
+            }
+          }
+          return request;
+        }
+
+        void startRequestTimer(std::chrono::steady_clock::time_point deadline) {
+          requestTimerDeadline_ = deadline;
+          std::chrono::milliseconds delay = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()) + std::chrono::milliseconds(1);
+          requestTimer_->restart(std::max(delay, std::chrono::milliseconds(1)), [this]() {
+            expireRequests();
+          });
+        }
+
+        void expireRequests() {
+          requestTimerDeadline_ = {};
+          std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+          std::chrono::steady_clock::time_point next;
+          for(size_t i = 0; i < requests_.size(); i++) {
+            Request &request = requests_[i];
+            if(request.isAbandoned || request.deadline == std::chrono::steady_clock::time_point()) {
+              continue;
+            }
+            if(request.deadline <= now) {
+              abandonRequest(request, MAKE_ERROR("Request timeout"));
+              if(!base_) {
+                return;
+              }
+            } else if(next == std::chrono::steady_clock::time_point() || request.deadline < next) {
+              next = request.deadline;
+            }
+          }
+          if(next != std::chrono::steady_clock::time_point()) {
+            startRequestTimer(next);
+          }
+        }
+
+        bool cancel(RequestId requestId) {
+          if(requestId == InvalidRequestId) {
+            return false;
+          }
+          for(Request &request : requests_) {
+            if(request.id == requestId && !request.isAbandoned) {
+              abandonRequest(request, MAKE_ERROR("Request cancelled"));
+              return true;
+            }
+          }
+          return false;
+        }
+
+        // the handler is completed right away. The cancel request hits whatever the server runs when it arrives, so it is
+        // sent only when the abandoned request is the only one in flight. Otherwise its results are just dropped
+        void abandonRequest(Request &request, const Error &error) {
+          Request abandoned;
+          abandoned.type = request.type;
+          abandoned.handler = std::move(request.handler);
+          abandoned.prepareHandler = std::move(request.prepareHandler);
+          abandoned.multiHandler = std::move(request.multiHandler);
+          abandoned.error = error;
+          request.isAbandoned = true;
+          if(statistics_) {
+            statistics_->increment(Statistics::Counter::Abandoned);
+            if(request.statementSeries) {
+              request.statementSeries->increment(Statistics::Counter::Abandoned);
+            }
+          }
+          if(requests_.size() == 1 && !base_->isCancelPending_) {
+            sendCancel();
+          }
+          completeRequest(abandoned, base_);
+        }
+
+        // PQcancel opens a new connection to the server and blocks, so it runs on the libuv thread pool. Until it is
+        // delivered no other request is sent, the cancel can't reach a request that was not meant
+        void sendCancel() {
+          struct CancelWork {
+            uv_work_t work;
+            PGcancel *cancel;
+            AsyncObjectPtr<Connection> connection;
+          };
+          PGcancel *cancel = PQgetCancel(handle_);
+          if(cancel == nullptr) {
+            return;
+          }
+          CancelWork *cancelWork = new CancelWork{{}, cancel, base_};
+          cancelWork->work.data = cancelWork;
+          base_->isCancelPending_ = true;
+          int rc = uv_queue_work(
+              base_->eventLoop()->handle(),
+              &cancelWork->work,
+              [](uv_work_t *work) {
+                char errorBuffer[256];
+                PQcancel(reinterpret_cast<CancelWork *>(work->data)->cancel, errorBuffer, sizeof(errorBuffer));
+              },
+              [](uv_work_t *work, int) {
+                CancelWork *cancelWork = reinterpret_cast<CancelWork *>(work->data);
+                PQfreeCancel(cancelWork->cancel);
+                AsyncObjectPtr<Connection> connection = std::move(cancelWork->connection);
+                delete cancelWork;
+                connection->isCancelPending_ = false;
+                if(connection->connectionImpl_) {
+                  connection->connectionImpl_->sendPendingListen();
+                }
+              });
+          if(rc != 0) {
+            base_->isCancelPending_ = false;
+            PQfreeCancel(cancel);
+            delete cancelWork;
+          }
+        }
+
+        // the request is already queued in libpq and pushed, a failure here can't be undone without losing
+        // the order of results, so the connection is dropped and the handler completed by reconnect
+        void finishSend() {
+          Error error = Error::Success;
+          if(PQpipelineStatus(handle_) != PQ_PIPELINE_OFF && PQpipelineSync(handle_) == 0) {
+            error = MAKE_ERROR("Unable to send pipeline sync. %s", PQerrorMessage(handle_));
+          } else {
+            error = flush();
+          }
+          if(error.isFail()) {
+            reconnect(error);
+          }
         }
 
         inline const ExecuteHandler &currentExecuteHandler() const {
-          return executeHandler_;
+          if(requests_.empty()) {
+            static ExecuteHandler dummy;
+            return dummy;
+          }
+          return requests_.front().handler;
         }
         inline RequestId currentRequestId() const {
-          return requestId_;
+          if(requests_.empty()) {
+            return InvalidRequestId;
+          }
+          return requests_.front().id;
         }
 
       private:
@@ -573,11 +1750,26 @@
         uv_poll_t *pollHandle_ = nullptr;
         int eventmask_ = 0;
         State state_ = State::Disconnected;
-        ExecuteHandler executeHandler_;
-        bool isExecuting_ = false;
-        RequestId requestId_;
+        size_t maxPipelineDepth_;
+        std::deque<Request> requests_;
+        bool isReadingPaused_ = false;
+        bool isProcessingResults_ = false;
+        bool isReset_ = false;
+        ServerRole role_ = ServerRole::Unknown;
+        std::vector<std::string> pendingListen_;
+        size_t internalRequests_ = 0;
         AsyncObjectPtr<Timer> connectTimer_;
+        AsyncObjectPtr<Timer> requestTimer_;
+        AsyncObjectPtr<Timer> attemptTimer_;
+        std::chrono::steady_clock::time_point requestTimerDeadline_;
+        std::vector<std::string> addresses_;
+        size_t addressIndex_ = 0;
         std::unordered_map<std::string, std::vector<Oid>> preparedStmtOids_;
+        std::vector<bool> preparedStatements_;
+        Statistics::Series *statistics_ = nullptr;
+        std::chrono::steady_clock::time_point stageStart_;
+        std::unordered_map<std::string, Statistics::Series *, StringHash, std::equal_to<>> statementSeries_;
+        std::vector<Statistics::Series *> registrySeries_;
       };
 
       //----------------------------------------------------------
@@ -595,20 +1787,12 @@
         connectedHandler_ = std::move(connectedHandler);
         disconnectedHandler_ = std::move(disconnectedHandler);
         if(options_.sslOptions().isAllow()) {
-          Error error = sslTemporaryFiles_.certificate_.create(options_.sslOptions().certificatePemData());
+          const SslOptions &sslOptions = options_.sslOptions();
+          Error error = SslCredentials::get(
+              sslOptions.certificatePemData(), sslOptions.privateKeyPemData(), sslOptions.trustedCertificatesPemData().empty() ? std::string_view() : std::string_view(sslOptions.trustedCertificatesPemData()[0]), sslCredentials_);
           if(error.isFail()) {
             return MAKE_CHILD_ERROR(error, "Unable to initialize postgresql connection");
           }
-          error = sslTemporaryFiles_.key_.create(options_.sslOptions().privateKeyPemData());
-          if(error.isFail()) {
-            return MAKE_CHILD_ERROR(error, "Unable to initialize postgresql connection");
-          }
-          if(!options_.sslOptions().trustedCertificatesPemData().empty()) {
-            error = sslTemporaryFiles_.ca_.create(options_.sslOptions().trustedCertificatesPemData()[0]);
-            if(error.isFail()) {
-              return MAKE_CHILD_ERROR(error, "Unable to initialize postgresql connection");
-            }
-          }
           if(options_.userName().empty()) {
             options_.setUserName(core::crypto::utils::getX509CommonName(options_.sslOptions().certificatePemData()));
           }
@@ -632,7 +1816,27 @@
         disconnectedHandler_ = {};
         options_ = {};
         id_ = {};
-        sslTemporaryFiles_.clear();
+        disconnectTime_ = {};
+        reconnectAttempt_ = 0;
+        subscriptions_.clear();
+        sslCredentials_.reset();
+      }
+
+      void Connection::subscribe(const std::string &channel, NotificationHandler &&handler) {
+        bool isNew = subscriptions_.insert_or_assign(channel, std::move(handler)).second;
+        if(isNew && connectionImpl_) {
+          connectionImpl_->listen("LISTEN", channel);
+        }
+      }
+
+      void Connection::unsubscribe(const std::string &channel) {
+        if(subscriptions_.erase(channel) != 0 && connectionImpl_) {
+          connectionImpl_->listen("UNLISTEN", channel);
+        }
+      }
+
+      Connection::ServerRole Connection::serverRole() const {
+        return connectionImpl_ ? connectionImpl_->serverRole() : ServerRole::Unknown;
       }
 
       bool Connection::isValid() const {
@@ -643,7 +1847,15 @@
         if(eventLoop()->state() != EventLoop::State::Running) {
           return Error::Success;
         }
-        if(!reconnectTimer_->restart(options_.reconnectInterval(), [this]() {
+        // exponential backoff with equal jitter, so connections lost at the same moment do not come back in lockstep
+        std::chrono::milliseconds delay = options_.reconnectInterval() * (int64_t(1) << std::min<size_t>(reconnectAttempt_, 16));
+        if(maxReconnectInterval_.count() > 0) {
+          delay = std::min(delay, std::max(maxReconnectInterval_, options_.reconnectInterval()));
+        }
+        thread_local std::minstd_rand random(std::random_device{}());
+        delay = delay / 2 + std::chrono::milliseconds(std::uniform_int_distribution<int64_t>(0, delay.count() / 2)(random));
+        reconnectAttempt_++;
+        if(!reconnectTimer_->restart(delay, [this]() {
              connectionImpl_ = new ConnectionImpl(AsyncObjectPtr<Connection>(this));
            })) {
           return MAKE_ERROR("Unable to start reconnect timer");
@@ -668,12 +1880,118 @@
         return connectionImpl_->prepare(name, query, types);
       }
 
-      void Connection::execute(const char *preparedName, const QueryData *queryData, ExecuteHandler &&handler, RequestId requestId) {
+      void Connection::execute(const char *preparedName, const QueryData *queryData, ExecuteHandler &&handler, RequestId requestId, std::chrono::milliseconds timeout) {
+        if(!connectionImpl_) {
+          handler(MAKE_ERROR("Connection is currently disconnected"), {}, {});
+          return;
+        }
+        return connectionImpl_->execute(preparedName, queryData, std::move(handler), requestId, timeout.count() > 0 ? timeout : requestTimeout_);
+      }
+
+      void Connection::execute(StatementId statementId, const QueryData *queryData, ExecuteHandler &&handler, RequestId requestId, std::chrono::milliseconds timeout) {
         if(!connectionImpl_) {
           handler(MAKE_ERROR("Connection is currently disconnected"), {}, {});
           return;
         }
-        return connectionImpl_->execute(preparedName, queryData, std::move(handler), requestId);
+        return connectionImpl_->execute(statementId, queryData, std::move(handler), requestId, timeout.count() > 0 ? timeout : requestTimeout_);
+      }
+
+      void Connection::execute(StatementId statementId, const ParameterView &parameters, ExecuteHandler &&handler, RequestId requestId) {
+        if(!connectionImpl_) {
+          handler(MAKE_ERROR("Connection is currently disconnected"), {}, {});
+          return;
+        }
+        if(static_cast<size_t>(statementId) >= StatementRegistry::instance()->size()) {
+          handler(MAKE_ERROR("Unknown statement %d", static_cast<size_t>(statementId)), {}, {});
+          return;
+        }
+        return connectionImpl_->send(statementId, parameters, std::move(handler), requestId, requestTimeout_);
+      }
+
+      bool Connection::cancel(RequestId requestId) {
+        return connectionImpl_ && connectionImpl_->cancel(requestId);
+      }
+
+      void Connection::reconnect(const Error &error) {
+        if(connectionImpl_) {
+          connectionImpl_->reconnect(error);
+        }
+      }
+
+      void Connection::setMaxReconnectInterval(std::chrono::milliseconds interval) {
+        maxReconnectInterval_ = interval;
+      }
+
+      void Connection::setRequestTimeout(std::chrono::milliseconds timeout) {
+        requestTimeout_ = timeout;
+      }
+
+      void Connection::executeQuery(const char *query, const QueryData *queryData, ExecuteHandler &&handler, RequestId requestId) {
+        if(!connectionImpl_) {
+          handler(MAKE_ERROR("Connection is currently disconnected"), {}, {});
+          return;
+        }
+        return connectionImpl_->executeQuery(query, queryData, std::move(handler), requestId);
+      }
+
+      void Connection::executeStreaming(const char *preparedName, const QueryData *queryData, RowHandler &&rowHandler, ExecuteHandler &&handler, RequestId requestId, size_t chunkSize) {
+        if(!connectionImpl_) {
+          handler(MAKE_ERROR("Connection is currently disconnected"), {}, {});
+          return;
+        }
+        return connectionImpl_->executeStreaming(preparedName, queryData, std::move(rowHandler), std::move(handler), requestId, chunkSize);
+      }
+
+      void Connection::copyFrom(const char *query, CopyInHandler &&copyInHandler, ExecuteHandler &&handler, RequestId requestId) {
+        if(!connectionImpl_) {
+          handler(MAKE_ERROR("Connection is currently disconnected"), {}, {});
+          return;
+        }
+        return connectionImpl_->copyFrom(query, std::move(copyInHandler), std::move(handler), requestId);
+      }
+
+      void Connection::executeMulti(const char *query, MultiExecuteHandler &&handler, RequestId requestId) {
+        if(!connectionImpl_) {
+          handler(MAKE_ERROR("Connection is currently disconnected"), {}, {});
+          return;
+        }
+        return connectionImpl_->executeMulti(query, std::move(handler), requestId);
+      }
+
+      void Connection::executeBatch(const std::vector<BatchQuery> &queries, MultiExecuteHandler &&handler, RequestId requestId) {
+        if(!connectionImpl_) {
+          handler(MAKE_ERROR("Connection is currently disconnected"), {}, {});
+          return;
+        }
+        return connectionImpl_->executeBatch(queries, std::move(handler), requestId);
+      }
+
+      void Connection::copyTo(const char *query, CopyOutHandler &&copyOutHandler, ExecuteHandler &&handler, RequestId requestId) {
+        if(!connectionImpl_) {
+          handler(MAKE_ERROR("Connection is currently disconnected"), {}, {});
+          return;
+        }
+        return connectionImpl_->copyTo(query, std::move(copyOutHandler), std::move(handler), requestId);
+      }
+
+      void Connection::pauseReading() {
+        if(connectionImpl_) {
+          connectionImpl_->pauseReading();
+        }
+      }
+
+      void Connection::resumeReading() {
+        if(connectionImpl_) {
+          connectionImpl_->resumeReading();
+        }
+      }
+
+      void Connection::prepare(const char *name, const char *query, const std::vector<unsigned int> *types, PrepareHandler &&handler) {
+        if(!connectionImpl_) {
+          handler(MAKE_ERROR("Connection is currently disconnected"), {});
+          return;
+        }
+        return connectionImpl_->prepare(name, query, types, std::move(handler));
       }
 
       RequestId Connection::currentRequestId() const {
@@ -695,5 +2013,16 @@
         return connectionImpl_ && connectionImpl_->isBusy();
       }
 
+      size_t Connection::pendingRequestCount() const {
+        if(!connectionImpl_) {
+          return 0;
+        }
+        return connectionImpl_->pendingRequestCount();
+      }
+
+      void Connection::setMaxPipelineDepth(size_t depth) {
+        maxPipelineDepth_ = std::max<size_t>(depth, 1);
+      }
+
     } // namespace postgresql
   }   // namespace core
@@ -3,18 +3,41 @@
 #include "core/microservice/timer.h"
 #include "options.h"
 #include "querydata.h"
+#include "statementregistry.h"
 #include "types.h"
+#include <chrono>
 #include <memory>
+#include <unordered_map>
 
   namespace core {
     namespace postgresql {
 
       class Recordset;
+      class SslCredentials;
 
       class Connection : public AsyncObject {
       public:
+        struct BatchQuery {
+          const char *preparedName;
+          const QueryData *queryData;
+        };
+
+        enum class ServerRole {
+          Unknown,
+          Primary,
+          Standby
+        };
+
         using ConnectedHandler = std::function<Error()>;
         using DisconnectedHandler = std::function<void(const Error &error)>;
+        using PrepareHandler = std::function<void(const Error &error, const AsyncObjectPtr<Connection> &connection)>;
+        using MultiExecuteHandler = std::function<void(const Error &error, std::vector<Recordset> &&results, const AsyncObjectPtr<Connection> &connection)>;
+        using RowHandler = std::function<void(Recordset &&rows, const AsyncObjectPtr<Connection> &connection)>;
+        // returns the next portion of copy data, it must stay valid until the next call. Empty data finishes the copy
+        using CopyInHandler = std::function<Error(std::string_view &data)>;
+        // data points into the libpq buffer and is valid only during the call
+        using CopyOutHandler = std::function<void(std::string_view data, const AsyncObjectPtr<Connection> &connection)>;
+        using NotificationHandler = std::function<void(std::string_view channel, std::string_view payload, const AsyncObjectPtr<Connection> &connection)>;
 
       public:
         virtual ~Connection();
@@ -23,7 +46,21 @@
         void destroy();
 
         bool isValid() const;
+        // known once the connected handler is called
+        ServerRole serverRole() const;
         bool isBusy() const;
+        size_t pendingRequestCount() const;
+
+        // depth greater than 1 enables libpq pipeline mode, applied on the next connect
+        void setMaxPipelineDepth(size_t depth);
+        void setRequestTimeout(std::chrono::milliseconds timeout);
+        // reconnect delay doubles from options().reconnectInterval() up to this limit, zero means no limit
+        void setMaxReconnectInterval(std::chrono::milliseconds interval);
+
+        // timed out and cancelled requests complete with an error at once, the connection stays usable
+        bool cancel(RequestId requestId);
+        // drops the connection and completes its requests with the error, it comes back when options().isAutoReconnect()
+        void reconnect(const Error &error);
 
         const Options &options() const;
 
@@ -31,7 +68,35 @@
         const std::string &host() const;
 
         // asynchronous
-        void execute(const char *preparedName, const QueryData *queryData, ExecuteHandler &&handler, RequestId requestId);
+        // timeout overrides the connection request timeout, zero means no limit for both
+        void execute(const char *preparedName, const QueryData *queryData, ExecuteHandler &&handler, RequestId requestId, std::chrono::milliseconds timeout = {});
+        // statement declared in StatementRegistry, prepared on this connection at first use
+        void execute(StatementId statementId, const QueryData *queryData, ExecuteHandler &&handler, RequestId requestId, std::chrono::milliseconds timeout = {});
+        // arguments are encoded in binary format into a buffer reused by every call
+        template <typename... Args>
+        void execute(TypedStatementId<Args...> statement, ExecuteHandler &&handler, RequestId requestId, const std::type_identity_t<Args> &...args);
+        void executeQuery(const char *query, const QueryData *queryData, ExecuteHandler &&handler, RequestId requestId);
+        void prepare(const char *name, const char *query, const std::vector<unsigned int> *types, PrepareHandler &&handler);
+
+        // results of every statement (query may contain several) or of every batch query, in order, within one round-trip.
+        // A failed query ends the list with its error result, the queries after it are not executed
+        void executeMulti(const char *query, MultiExecuteHandler &&handler, RequestId requestId);
+        void executeBatch(const std::vector<BatchQuery> &queries, MultiExecuteHandler &&handler, RequestId requestId);
+
+        // rows are passed to rowHandler as they arrive (chunkSize rows at once when libpq supports chunked mode),
+        // handler is called when the query is complete. pauseReading/resumeReading throttle the delivery
+        void executeStreaming(const char *preparedName, const QueryData *queryData, RowHandler &&rowHandler, ExecuteHandler &&handler, RequestId requestId, size_t chunkSize = 1);
+        void pauseReading();
+        void resumeReading();
+
+        // query is COPY ... FROM STDIN, data is requested from copyInHandler whenever the socket can take more
+        void copyFrom(const char *query, CopyInHandler &&copyInHandler, ExecuteHandler &&handler, RequestId requestId);
+        // query is COPY ... TO STDOUT, every row is passed to copyOutHandler, pauseReading/resumeReading throttle the delivery
+        void copyTo(const char *query, CopyOutHandler &&copyOutHandler, ExecuteHandler &&handler, RequestId requestId);
+
+        // LISTEN on the channel, sent again after every reconnect. Notifications are delivered while the connection is polled
+        void subscribe(const std::string &channel, NotificationHandler &&handler);
+        void unsubscribe(const std::string &channel);
 
         // synchronous
         Error prepare(const char *name, const char *query, const std::vector<unsigned int> *types = nullptr);
@@ -49,38 +114,29 @@
         friend AsyncObjectPtr<Connection>;
 
         Error startReconnectTimer();
+        void execute(StatementId statementId, const ParameterView &parameters, ExecuteHandler &&handler, RequestId requestId);
 
       private:
         ConnectionId id_;
         Options options_;
         size_t hostIndex_;
+        size_t maxPipelineDepth_ = 1;
+        std::chrono::milliseconds requestTimeout_ = {};
         ConnectedHandler connectedHandler_;
         DisconnectedHandler disconnectedHandler_;
         class ConnectionImpl;
         ConnectionImpl *connectionImpl_ = nullptr;
         AsyncObjectPtr<Timer> reconnectTimer_;
+        std::chrono::steady_clock::time_point disconnectTime_;
+        std::chrono::milliseconds maxReconnectInterval_ = std::chrono::seconds(30);
+        size_t reconnectAttempt_ = 0;
+        // kept on the connection, a cancel in flight outlives a reconnect
+        bool isCancelPending_ = false;
         ByteArray userData_;
+        std::string parameterArena_;
+        std::unordered_map<std::string, NotificationHandler> subscriptions_;
 
-        class SslTmpFile {
-        public:
-          SslTmpFile() = default;
-          ~SslTmpFile();
-          Error create(std::string_view data);
-          const std::string &path() const;
-          void clear();
-
-        private:
-          SslTmpFile &operator=(const SslTmpFile &) = delete;
-          std::string path_;
-          std::FILE *f_ = nullptr;
-        };
-
-        struct SslTemporaryFiles {
-          SslTmpFile certificate_;
-          SslTmpFile key_;
-          SslTmpFile ca_;
-          void clear();
-        } sslTemporaryFiles_;
+        std::shared_ptr<const SslCredentials> sslCredentials_;
       };
 
       inline ConnectionId Connection::id() const {
@@ -96,5 +152,11 @@
         return options_.hosts()[hostIndex_];
       }
 
+      template <typename... Args>
+      void Connection::execute(TypedStatementId<Args...> statement, ExecuteHandler &&handler, RequestId requestId, const std::type_identity_t<Args> &...args) {
+        QueryParameters<Args...> parameters(parameterArena_, args...);
+        execute(statement.id(), parameters.view(), std::move(handler), requestId);
+      }
+
     } // namespace postgresql
   }   // namespace core
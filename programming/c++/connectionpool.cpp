@@ -0,0 +1,400 @@
+#include "connectionpool.h"
+#include "core/microservice/eventloop.h"
+#include "recordset.h"
+#include "statistics.h"
+#include <algorithm>
+#include <tuple>
+
+  namespace core {
+    namespace postgresql {
+
+      ConnectionPool::ConnectionPool(EventLoop *eventLoop) :
+          AsyncObject(eventLoop), waitTimer_(CONSTRUCT_ASYNC_OBJECT("ConnectionPool::waitTimer_"), eventLoop), idleTimer_(CONSTRUCT_ASYNC_OBJECT("ConnectionPool::idleTimer_"), eventLoop) {}
+
+      ConnectionPool::~ConnectionPool() {
+        destroy();
+      }
+
+      Error ConnectionPool::initialize(const Options &options, const Settings &settings) {
+        destroy();
+        isDestroying_ = false;
+        if(options.hosts().empty()) {
+          return MAKE_ERROR("Unable to initialize postgresql connection pool. Host list is empty");
+        }
+        if(settings.maxSize == 0 || settings.minSize > settings.maxSize) {
+          return MAKE_ERROR("Unable to initialize postgresql connection pool. Wrong pool size");
+        }
+        options_ = options;
+        settings_ = settings;
+        hosts_.resize(options_.hosts().size());
+        for(size_t i = 0; i < settings_.minSize; i++) {
+          Error error = addConnection(i % hosts_.size());
+          if(error.isFail()) {
+            destroy();
+            return MAKE_CHILD_ERROR(error, "Unable to initialize postgresql connection pool");
+          }
+        }
+        if(settings_.idleTimeout.count() > 0 && settings_.maxSize > settings_.minSize) {
+          idleTimer_->restart(settings_.idleTimeout, [this]() {
+            closeIdleConnections();
+          });
+        }
+        return Error::Success;
+      }
+
+      // destroyed connections complete their requests at once, the handlers must not hand waiters to them
+      void ConnectionPool::destroy() {
+        isDestroying_ = true;
+        waitTimer_->stop();
+        idleTimer_->stop();
+        std::deque<WaitingRequest> waitingRequests = std::move(waitingRequests_);
+        waitingRequests_.clear();
+        for(WaitingRequest &request : waitingRequests) {
+          request.handler(MAKE_ERROR("Connection pool is destroyed"), {}, {});
+        }
+        for(std::unique_ptr<Slot> &slot : slots_) {
+          slot->connection->destroy();
+        }
+        slots_.clear();
+        hosts_.clear();
+        connectedCount_ = 0;
+        isConnectionIdUsed_.clear();
+        statements_.clear();
+        options_ = {};
+      }
+
+      void ConnectionPool::addPreparedStatement(const char *name, const char *query, const std::vector<unsigned int> *types, StatementErrorHandler &&errorHandler) {
+        Statement &statement = statements_.emplace_back();
+        statement.name = name;
+        statement.query = query;
+        statement.hasTypes = types != nullptr;
+        if(types) {
+          statement.types = *types;
+        }
+        statement.errorHandler = std::move(errorHandler);
+        for(std::unique_ptr<Slot> &slot : slots_) {
+          makeReady(slot.get());
+        }
+      }
+
+      Error ConnectionPool::addConnection(size_t hostIndex) {
+        std::unique_ptr<Slot> slot = std::make_unique<Slot>();
+        slot->hostIndex = hostIndex;
+        slot->idleSince = std::chrono::steady_clock::now();
+        slot->connection = AsyncObjectPtr<Connection>(CONSTRUCT_ASYNC_OBJECT("ConnectionPool::connection"), eventLoop());
+        slot->connection->setMaxPipelineDepth(settings_.maxPipelineDepth);
+        slot->connection->setMaxReconnectInterval(settings_.maxReconnectInterval);
+        Slot *s = slot.get();
+        slots_.push_back(std::move(slot));
+        hosts_[hostIndex].connectionCount++;
+        ConnectionId id = allocateConnectionId();
+        Error error = s->connection->initialize(
+            id,
+            options_,
+            hostIndex,
+            [this, s]() -> Error {
+              return onConnected(s);
+            },
+            [this, s](const Error &) {
+              onDisconnected(s);
+            });
+        if(error.isFail()) {
+          releaseConnectionId(id);
+          hosts_[hostIndex].connectionCount--;
+          slots_.pop_back();
+          return error;
+        }
+        return Error::Success;
+      }
+
+      Error ConnectionPool::onConnected(Slot *slot) {
+        slot->isConnected = true;
+        slot->preparedCount = 0;
+        slot->isPrepareFailed = false;
+        connectedCount_++;
+        makeReady(slot);
+        drainWaitQueue();
+        return Error::Success;
+      }
+
+      void ConnectionPool::onDisconnected(Slot *slot) {
+        if(slot->isConnected) {
+          slot->isConnected = false;
+          connectedCount_--;
+        }
+      }
+
+      void ConnectionPool::makeReady(Slot *slot) {
+        if(isDestroying_ || !slot->isConnected || slot->isPreparing || slot->isPrepareFailed || slot->connection->isBusy()) {
+          return;
+        }
+        if(slot->preparedCount < statements_.size()) {
+          prepareNext(slot);
+          return;
+        }
+        if(!slot->isReady) {
+          slot->isReady = true;
+          hosts_[slot->hostIndex].ready.push_back(slot);
+        }
+      }
+
+      void ConnectionPool::prepareNext(Slot *slot) {
+        const Statement &statement = statements_[slot->preparedCount];
+        slot->isPreparing = true;
+        slot->isPrepareSent = false;
+        slot->connection->prepare(
+            statement.name.c_str(),
+            statement.query.c_str(),
+            statement.hasTypes ? &statement.types : nullptr,
+            [pool = AsyncObjectPtr<ConnectionPool>(this), slot, name = statement.name](const Error &error, const AsyncObjectPtr<Connection> &) {
+              slot->isPreparing = false;
+              if(pool->isDestroying_) {
+                return;
+              }
+              if(error.isFail()) {
+                // the server rejected the statement, it would fail on every connection again
+                if(slot->isPrepareSent && slot->connection->isValid()) {
+                  pool->dropStatement(name, error);
+                  pool->makeReady(slot);
+                  pool->drainWaitQueue();
+                  return;
+                }
+                // the connection stays out of rotation until it reconnects and prepares again
+                slot->isPrepareFailed = true;
+                slot->connection->reconnect(error);
+                return;
+              }
+              slot->preparedCount++;
+              pool->makeReady(slot);
+              pool->drainWaitQueue();
+            });
+        // a handler called from prepare itself failed to send
+        if(slot->isPreparing) {
+          slot->isPrepareSent = true;
+        }
+      }
+
+      // slots count prepared statements from the start of the list, the ones past the dropped statement keep their place
+      void ConnectionPool::dropStatement(const std::string &name, const Error &error) {
+        std::vector<Statement>::iterator i = std::find_if(statements_.begin(), statements_.end(), [&name](const Statement &statement) {
+          return statement.name == name;
+        });
+        if(i == statements_.end()) {
+          return;
+        }
+        size_t index = static_cast<size_t>(i - statements_.begin());
+        StatementErrorHandler errorHandler = std::move(i->errorHandler);
+        statements_.erase(i);
+        for(std::unique_ptr<Slot> &slot : slots_) {
+          if(slot->preparedCount > index) {
+            slot->preparedCount--;
+          }
+        }
+        if(errorHandler) {
+          errorHandler(MAKE_CHILD_ERROR(error, "Unable to prepare statement %s", name.c_str()));
+        }
+      }
+
+      // writes go to the primary only, reads prefer standbys and fall back to the primary
+      ConnectionPool::Slot *ConnectionPool::acquire(Intent intent) {
+        Host *best = nullptr;
+        Host *bestStandby = nullptr;
+        for(Host &host : hosts_) {
+          // busy and disconnected slots are dropped lazily, they come back through makeReady
+          while(!host.ready.empty() && (!host.ready.front()->isConnected || host.ready.front()->preparedCount < statements_.size() || host.ready.front()->connection->isBusy())) {
+            host.ready.front()->isReady = false;
+            host.ready.pop_front();
+          }
+          if(host.ready.empty()) {
+            continue;
+          }
+          bool isStandby = host.ready.front()->connection->serverRole() == Connection::ServerRole::Standby;
+          if(isStandby && intent == Intent::ReadWrite) {
+            continue;
+          }
+          if(best == nullptr || isBetter(host, *best)) {
+            best = &host;
+          }
+          if(isStandby && (bestStandby == nullptr || isBetter(host, *bestStandby))) {
+            bestStandby = &host;
+          }
+        }
+        if(bestStandby) {
+          best = bestStandby;
+        }
+        if(best == nullptr) {
+          return nullptr;
+        }
+        Slot *slot = best->ready.front();
+        best->ready.pop_front();
+        slot->isReady = false;
+        return slot;
+      }
+
+      bool ConnectionPool::isBetter(const Host &host, const Host &best) const {
+        switch(settings_.balancingPolicy) {
+          case BalancingPolicy::LeastOutstandingRequests:
+            return host.outstandingRequests < best.outstandingRequests || (host.outstandingRequests == best.outstandingRequests && host.latency < best.latency);
+          case BalancingPolicy::Latency:
+            return host.latency < best.latency;
+        }
+        return false;
+      }
+
+      void ConnectionPool::execute(const char *preparedName, const QueryData *queryData, ExecuteHandler &&handler, RequestId requestId, Intent intent) {
+        if(isDestroying_) {
+          handler(MAKE_ERROR("Connection pool is destroyed"), {}, {});
+          return;
+        }
+        if(waitingRequests_.empty()) {
+          Slot *slot = acquire(intent);
+          if(slot) {
+            send(slot, preparedName, queryData, std::move(handler), requestId, {});
+            return;
+          }
+        }
+        if(waitingRequests_.size() >= settings_.maxWaitQueueSize) {
+          handler(MAKE_ERROR("Connection pool wait queue is full"), {}, {});
+          return;
+        }
+        if(waitingRequests_.empty()) {
+          waitTimer_->restart(settings_.waitTimeout, [this]() {
+            expireWaitingRequests();
+          });
+        }
+        bool isQueueEmpty = waitingRequests_.empty();
+        waitingRequests_.push_back({preparedName, queryData, std::move(handler), requestId, intent, std::chrono::steady_clock::now() + settings_.waitTimeout});
+        // the waiters ahead may be held back by an intent this request does not have
+        if(!isQueueEmpty) {
+          drainWaitQueue();
+        }
+        if(!waitingRequests_.empty()) {
+          grow();
+        }
+      }
+
+      void ConnectionPool::send(Slot *slot, const char *preparedName, const QueryData *queryData, ExecuteHandler &&handler, RequestId requestId, std::chrono::steady_clock::duration queueTime) {
+        Host &host = hosts_[slot->hostIndex];
+        host.outstandingRequests++;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if(Statistics::instance()->isEnabled()) {
+          Statistics::instance()->statementSeries(slot->hostIndex, preparedName)->record(Statistics::Stage::Queue, queueTime);
+        }
+        slot->connection->execute(
+            preparedName,
+            queryData,
+            [pool = AsyncObjectPtr<ConnectionPool>(this), slot, start, handler = std::move(handler)](const Error &error, Recordset &&result, const AsyncObjectPtr<Connection> &connection) {
+              Host &host = pool->hosts_[slot->hostIndex];
+              host.outstandingRequests--;
+              std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+              slot->idleSince = now;
+              if(error.isSuccess()) {
+                double latency = static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(now - start).count());
+                host.latency = host.latency == 0 ? latency : host.latency + (latency - host.latency) / 8;
+              }
+              if(handler) {
+                handler(error, std::move(result), connection);
+              }
+              if(!pool->isDestroying_) {
+                pool->makeReady(slot);
+                pool->drainWaitQueue();
+              }
+            },
+            requestId);
+        makeReady(slot);
+      }
+
+      void ConnectionPool::grow() {
+        size_t connectingCount = slots_.size() - connectedCount_;
+        if(slots_.size() >= settings_.maxSize || connectingCount >= waitingRequests_.size()) {
+          return;
+        }
+        size_t hostIndex = 0;
+        for(size_t i = 1; i < hosts_.size(); i++) {
+          if(hosts_[i].connectionCount < hosts_[hostIndex].connectionCount) {
+            hostIndex = i;
+          }
+        }
+        std::ignore = addConnection(hostIndex);
+      }
+
+      // waiters are served in order within an intent, a read only waiter is not held back by writes waiting for the primary
+      void ConnectionPool::drainWaitQueue() {
+        bool isReadWriteBlocked = false;
+        bool isReadOnlyBlocked = false;
+        size_t i = 0;
+        while(i < waitingRequests_.size() && !(isReadWriteBlocked && isReadOnlyBlocked)) {
+          Intent intent = waitingRequests_[i].intent;
+          bool &isBlocked = intent == Intent::ReadWrite ? isReadWriteBlocked : isReadOnlyBlocked;
+          if(isBlocked) {
+            i++;
+            continue;
+          }
+          Slot *slot = acquire(intent);
+          if(slot == nullptr) {
+            isBlocked = true;
+            i++;
+            continue;
+          }
+          WaitingRequest request = std::move(waitingRequests_[i]);
+          waitingRequests_.erase(waitingRequests_.begin() + static_cast<std::ptrdiff_t>(i));
+          std::chrono::steady_clock::duration queueTime = std::chrono::steady_clock::now() - (request.deadline - settings_.waitTimeout);
+          send(slot, request.preparedName.c_str(), request.queryData, std::move(request.handler), request.requestId, queueTime);
+          // handlers may have changed the queue
+          i = 0;
+        }
+        if(waitingRequests_.empty()) {
+          waitTimer_->stop();
+        }
+      }
+
+      void ConnectionPool::expireWaitingRequests() {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        while(!waitingRequests_.empty() && waitingRequests_.front().deadline <= now) {
+          WaitingRequest request = std::move(waitingRequests_.front());
+          waitingRequests_.pop_front();
+          request.handler(MAKE_ERROR("Connection pool wait timeout"), {}, {});
+        }
+        if(!waitingRequests_.empty()) {
+          waitTimer_->restart(std::chrono::duration_cast<std::chrono::milliseconds>(waitingRequests_.front().deadline - now) + std::chrono::milliseconds(1), [this]() {
+            expireWaitingRequests();
+          });
+        }
+      }
+
+      ConnectionId ConnectionPool::allocateConnectionId() {
+        std::vector<bool>::iterator i = std::find(isConnectionIdUsed_.begin(), isConnectionIdUsed_.end(), false);
+        size_t id = static_cast<size_t>(i - isConnectionIdUsed_.begin());
+        if(i == isConnectionIdUsed_.end()) {
+          isConnectionIdUsed_.push_back(true);
+        } else {
+          *i = true;
+        }
+        return static_cast<ConnectionId>(id);
+      }
+
+      void ConnectionPool::releaseConnectionId(ConnectionId id) {
+        isConnectionIdUsed_[static_cast<size_t>(id)] = false;
+      }
+
+      void ConnectionPool::closeIdleConnections() {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for(size_t i = slots_.size(); i > 0 && slots_.size() > settings_.minSize && waitingRequests_.empty(); i--) {
+          Slot *slot = slots_[i - 1].get();
+          if(slot->isPreparing || slot->connection->pendingRequestCount() != 0 || now - slot->idleSince < settings_.idleTimeout) {
+            continue;
+          }
+          releaseConnectionId(slot->connection->id());
+          slot->connection->destroy();
+          Host &host = hosts_[slot->hostIndex];
+          std::erase(host.ready, slot);
+          host.connectionCount--;
+          slots_.erase(slots_.begin() + static_cast<std::ptrdiff_t>(i - 1));
+        }
+        idleTimer_->restart(settings_.idleTimeout, [this]() {
+          closeIdleConnections();
+        });
+      }
+
+    } // namespace postgresql
+  }   // namespace core
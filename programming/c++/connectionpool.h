@@ -0,0 +1,143 @@
+#pragma once
+#include "connection.h"
+#include <chrono>
+#include <deque>
+#include <memory>
+
+  namespace core {
+    namespace postgresql {
+
+      class ConnectionPool : public AsyncObject {
+      public:
+        enum class BalancingPolicy {
+          LeastOutstandingRequests,
+          Latency
+        };
+
+        enum class Intent {
+          ReadWrite,
+          ReadOnly
+        };
+
+        struct Settings {
+          size_t minSize = 1;
+          size_t maxSize = 16;
+          size_t maxPipelineDepth = 1;
+          size_t maxWaitQueueSize = 1024;
+          std::chrono::milliseconds waitTimeout = std::chrono::milliseconds(5000);
+          std::chrono::milliseconds maxReconnectInterval = std::chrono::seconds(30);
+          // connections above minSize without requests for this long are closed, zero keeps them
+          std::chrono::milliseconds idleTimeout = std::chrono::seconds(60);
+          BalancingPolicy balancingPolicy = BalancingPolicy::LeastOutstandingRequests;
+        };
+
+        using StatementErrorHandler = std::function<void(const Error &error)>;
+
+      public:
+        virtual ~ConnectionPool();
+
+        Error initialize(const Options &options, const Settings &settings);
+        void destroy();
+
+        // statement is prepared on every connection of the pool, including reconnected ones. A statement the server
+        // rejects is dropped from the pool and reported to errorHandler
+        void addPreparedStatement(const char *name, const char *query, const std::vector<unsigned int> *types = nullptr, StatementErrorHandler &&errorHandler = {});
+
+        // queryData must stay valid until the handler is called. Read only requests are spread over standby hosts
+        void execute(const char *preparedName, const QueryData *queryData, ExecuteHandler &&handler, RequestId requestId, Intent intent = Intent::ReadWrite);
+
+        const Options &options() const;
+        const Settings &settings() const;
+        size_t size() const;
+        size_t waitingRequestCount() const;
+
+      protected:
+        ConnectionPool(EventLoop *eventLoop);
+        friend AsyncObjectPtr<ConnectionPool>;
+
+      private:
+        struct Slot {
+          AsyncObjectPtr<Connection> connection;
+          size_t hostIndex = 0;
+          size_t preparedCount = 0;
+          bool isConnected = false;
+          bool isReady = false;
+          bool isPreparing = false;
+          bool isPrepareFailed = false;
+          // the prepare in flight reached the server, a failure is then the one of the statement
+          bool isPrepareSent = false;
+          std::chrono::steady_clock::time_point idleSince;
+        };
+
+        struct Host {
+          std::deque<Slot *> ready;
+          size_t connectionCount = 0;
+          size_t outstandingRequests = 0;
+          double latency = 0; // microseconds, exponentially weighted
+        };
+
+        struct WaitingRequest {
+          std::string preparedName;
+          const QueryData *queryData;
+          ExecuteHandler handler;
+          RequestId requestId;
+          Intent intent;
+          std::chrono::steady_clock::time_point deadline;
+        };
+
+        struct Statement {
+          std::string name;
+          std::string query;
+          std::vector<unsigned int> types;
+          bool hasTypes;
+          StatementErrorHandler errorHandler;
+        };
+
+        Error addConnection(size_t hostIndex);
+        Error onConnected(Slot *slot);
+        void onDisconnected(Slot *slot);
+        void makeReady(Slot *slot);
+        void prepareNext(Slot *slot);
+        void dropStatement(const std::string &name, const Error &error);
+        Slot *acquire(Intent intent);
+        bool isBetter(const Host &host, const Host &best) const;
+        void send(Slot *slot, const char *preparedName, const QueryData *queryData, ExecuteHandler &&handler, RequestId requestId, std::chrono::steady_clock::duration queueTime);
+        void grow();
+        void drainWaitQueue();
+        void expireWaitingRequests();
+        void closeIdleConnections();
+        ConnectionId allocateConnectionId();
+        void releaseConnectionId(ConnectionId id);
+
+      private:
+        Options options_;
+        Settings settings_;
+        std::vector<std::unique_ptr<Slot>> slots_;
+        std::vector<Host> hosts_;
+        size_t connectedCount_ = 0;
+        // set by destroy until the next initialize, handlers running after destroy must not touch the freed slots
+        bool isDestroying_ = false;
+        std::deque<WaitingRequest> waitingRequests_;
+        AsyncObjectPtr<Timer> waitTimer_;
+        AsyncObjectPtr<Timer> idleTimer_;
+        // ids of live connections, the lowest free one is taken, so a connection replacing a closed one records
+        // into the same statistics series
+        std::vector<bool> isConnectionIdUsed_;
+        std::vector<Statement> statements_;
+      };
+
+      inline const Options &ConnectionPool::options() const {
+        return options_;
+      }
+      inline const ConnectionPool::Settings &ConnectionPool::settings() const {
+        return settings_;
+      }
+      inline size_t ConnectionPool::size() const {
+        return slots_.size();
+      }
+      inline size_t ConnectionPool::waitingRequestCount() const {
+        return waitingRequests_.size();
+      }
+
+    } // namespace postgresql
+  }   // namespace core
@@ -0,0 +1,691 @@
+#include "fakeserver.h"
+#include <algorithm>
+#include <cctype>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <tuple>
+#include <unistd.h>
+
+  namespace core {
+    namespace postgresql {
+
+      namespace {
+        constexpr int32_t ProtocolVersion = 196608;
+        constexpr int32_t SslRequestCode = 80877103;
+        constexpr int32_t CancelRequestCode = 80877102;
+        constexpr int32_t GssRequestCode = 80877104;
+
+        constexpr uint32_t BoolOid = 16;
+        constexpr uint32_t Int4Oid = 23;
+        constexpr uint32_t TextOid = 25;
+        constexpr uint32_t UuidOid = 2950;
+
+        void append16(std::string &out, int16_t value) {
+          uint16_t v = htons(static_cast<uint16_t>(value));
+          out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+        }
+
+        void append32(std::string &out, int32_t value) {
+          uint32_t v = htonl(static_cast<uint32_t>(value));
+          out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+        }
+
+        int16_t read16(const char *data) {
+          uint16_t v;
+          std::memcpy(&v, data, sizeof(v));
+          return static_cast<int16_t>(ntohs(v));
+        }
+
+        int32_t read32(const char *data) {
+          uint32_t v;
+          std::memcpy(&v, data, sizeof(v));
+          return static_cast<int32_t>(ntohl(v));
+        }
+
+        // typed message, the length is filled in by the destructor
+        class Message {
+        public:
+          Message(std::string &out, char type) : out_(out) {
+            out_.push_back(type);
+            offset_ = out_.size();
+            append32(out_, 0);
+          }
+          ~Message() {
+            uint32_t length = htonl(static_cast<uint32_t>(out_.size() - offset_));
+            std::memcpy(&out_[offset_], &length, sizeof(length));
+          }
+          Message &int16(int16_t value) {
+            append16(out_, value);
+            return *this;
+          }
+          Message &int32(int32_t value) {
+            append32(out_, value);
+            return *this;
+          }
+          Message &string(std::string_view value) {
+            out_.append(value);
+            out_.push_back('\0');
+            return *this;
+          }
+          Message &bytes(std::string_view value) {
+            out_.append(value);
+            return *this;
+          }
+
+        private:
+          std::string &out_;
+          size_t offset_;
+        };
+
+        // reads a null terminated string and moves past it
+        std::string_view readString(std::string_view &body) {
+          size_t end = body.find('\0');
+          if(end == std::string_view::npos) {
+            std::string_view value = body;
+            body = {};
+            return value;
+          }
+          std::string_view value = body.substr(0, end);
+          body.remove_prefix(end + 1);
+          return value;
+        }
+
+        // highest $n of the query
+        size_t countParameters(std::string_view query) {
+          size_t count = 0;
+          for(size_t i = 0; i < query.size(); i++) {
+            if(query[i] != '$') {
+              continue;
+            }
+            size_t n = 0;
+            while(i + 1 < query.size() && query[i + 1] >= '0' && query[i + 1] <= '9') {
+              n = n * 10 + static_cast<size_t>(query[++i] - '0');
+            }
+            count = std::max(count, n);
+          }
+          return count;
+        }
+
+        bool startsWith(std::string_view value, std::string_view prefix) {
+          if(value.size() < prefix.size()) {
+            return false;
+          }
+          for(size_t i = 0; i < prefix.size(); i++) {
+            if(std::toupper(static_cast<unsigned char>(value[i])) != prefix[i]) {
+              return false;
+            }
+          }
+          return true;
+        }
+
+        bool contains(std::string_view value, std::string_view part) {
+          std::string upper(value);
+          std::transform(upper.begin(), upper.end(), upper.begin(), [](unsigned char c) {
+            return static_cast<char>(std::toupper(c));
+          });
+          return upper.find(part) != std::string::npos;
+        }
+
+        std::string_view trim(std::string_view value) {
+          while(!value.empty() && std::isspace(static_cast<unsigned char>(value.front()))) {
+            value.remove_prefix(1);
+          }
+          while(!value.empty() && std::isspace(static_cast<unsigned char>(value.back()))) {
+            value.remove_suffix(1);
+          }
+          return value;
+        }
+
+        std::string unquote(std::string_view value) {
+          value = trim(value);
+          if(value.size() >= 2 && (value.front() == '"' || value.front() == '\'') && value.back() == value.front()) {
+            value = value.substr(1, value.size() - 2);
+          }
+          return std::string(value);
+        }
+
+        constexpr unsigned char RowUuid[16] = {0x6b, 0xa7, 0xb8, 0x10, 0x9d, 0xad, 0x11, 0xd1, 0x80, 0xb4, 0x00, 0xc0, 0x4f, 0xd4, 0x30, 0xc8};
+        constexpr std::string_view RowUuidText = "6ba7b810-9dad-11d1-80b4-00c04fd430c8";
+        constexpr std::string_view RowName = "member";
+      } // namespace
+
+      FakeServer::~FakeServer() {
+        stop();
+      }
+
+      Error FakeServer::start(const Settings &settings) {
+        stop();
+        settings_ = settings;
+        executeCount_.store(0, std::memory_order_relaxed);
+        listenFd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(listenFd_ < 0) {
+          return MAKE_ERROR("Unable to create socket. %s", strerror(errno));
+        }
+        int on = 1;
+        setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(settings_.port);
+        socklen_t length = sizeof(address);
+        if(bind(listenFd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(listenFd_, 128) != 0 ||
+           getsockname(listenFd_, reinterpret_cast<sockaddr *>(&address), &length) != 0) {
+          Error error = MAKE_ERROR("Unable to listen. %s", strerror(errno));
+          stop();
+          return error;
+        }
+        port_ = ntohs(address.sin_port);
+        if(pipe2(wakeFds_, O_CLOEXEC | O_NONBLOCK) != 0) {
+          Error error = MAKE_ERROR("Unable to create pipe. %s", strerror(errno));
+          stop();
+          return error;
+        }
+        thread_ = std::thread([this]() {
+          run();
+        });
+        return Error::Success;
+      }
+
+      void FakeServer::stop() {
+        if(thread_.joinable()) {
+          char byte = 0;
+          std::ignore = ::write(wakeFds_[1], &byte, 1);
+          thread_.join();
+        }
+        for(std::unique_ptr<Client> &client : clients_) {
+          close(client->fd);
+        }
+        clients_.clear();
+        for(int *fd : {&listenFd_, &wakeFds_[0], &wakeFds_[1]}) {
+          if(*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+          }
+        }
+        port_ = 0;
+      }
+
+      void FakeServer::run() {
+        std::vector<pollfd> fds;
+        while(true) {
+          std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+          int timeout = -1;
+          fds.clear();
+          fds.push_back({wakeFds_[0], POLLIN, 0});
+          fds.push_back({listenFd_, POLLIN, 0});
+          for(std::unique_ptr<Client> &client : clients_) {
+            while(!client->delayed.empty() && client->delayed.front().first <= now) {
+              client->ready.append(client->delayed.front().second);
+              client->delayed.pop_front();
+            }
+            if(!client->delayed.empty()) {
+              int64_t wait = std::chrono::duration_cast<std::chrono::milliseconds>(client->delayed.front().first - now).count() + 1;
+              timeout = timeout < 0 ? static_cast<int>(wait) : std::min(timeout, static_cast<int>(wait));
+            }
+            fds.push_back({client->fd, static_cast<short>(POLLIN | (client->ready.empty() ? 0 : POLLOUT)), 0});
+          }
+          if(poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) {
+            return;
+          }
+          if(fds[0].revents) {
+            return;
+          }
+          if(fds[1].revents & POLLIN) {
+            accept();
+          }
+          for(size_t i = 2; i < fds.size(); i++) {
+            Client &client = *clients_[i - 2];
+            if(fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+              read(client);
+            }
+            if(!client.isClosed && !client.ready.empty()) {
+              write(client);
+            }
+          }
+          clients_.erase(std::remove_if(clients_.begin(),
+                                        clients_.end(),
+                                        [](const std::unique_ptr<Client> &client) {
+                                          if(client->isClosed) {
+                                            close(client->fd);
+                                          }
+                                          return client->isClosed;
+                                        }),
+                         clients_.end());
+        }
+      }
+
+      void FakeServer::accept() {
+        int fd = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0) {
+          return;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        std::unique_ptr<Client> client = std::make_unique<Client>();
+        client->fd = fd;
+        client->pid = nextPid_++;
+        clients_.push_back(std::move(client));
+      }
+
+      void FakeServer::read(Client &client) {
+        char buffer[65536];
+        while(true) {
+          ssize_t rc = recv(client.fd, buffer, sizeof(buffer), 0);
+          if(rc > 0) {
+            client.input.append(buffer, static_cast<size_t>(rc));
+            continue;
+          }
+          if(rc == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            client.isClosed = true;
+            return;
+          }
+          if(errno != EINTR) {
+            break;
+          }
+        }
+        size_t offset = 0;
+        while(!client.isClosed) {
+          if(!client.isStarted) {
+            if(client.input.size() - offset < 8) {
+              break;
+            }
+            size_t length = static_cast<size_t>(read32(client.input.data() + offset));
+            if(client.input.size() - offset < length) {
+              break;
+            }
+            std::string_view body(client.input.data() + offset + 4, length - 4);
+            offset += length;
+            int32_t code = read32(body.data());
+            if(code == SslRequestCode || code == GssRequestCode) {
+              client.ready.push_back('N');
+              continue;
+            }
+            if(code == CancelRequestCode && body.size() >= 8) {
+              cancel(read32(body.data() + 4));
+            }
+            if(code == CancelRequestCode || code != ProtocolVersion) {
+              client.isClosed = true;
+              break;
+            }
+            client.isStarted = true;
+            Message(client.output, 'R').int32(0);
+            for(std::pair<const char *, const char *> parameter : {std::pair("server_version", "16.0"),
+                                                                   std::pair("server_encoding", "UTF8"),
+                                                                   std::pair("client_encoding", "UTF8"),
+                                                                   std::pair("DateStyle", "ISO, MDY"),
+                                                                   std::pair("integer_datetimes", "on"),
+                                                                   std::pair("standard_conforming_strings", "on"),
+                                                                   std::pair("in_hot_standby", "off")}) {
+              Message(client.output, 'S').string(parameter.first).string(parameter.second);
+            }
+            Message(client.output, 'K').int32(client.pid).int32(client.pid);
+            Message(client.output, 'Z').bytes("I");
+            flush(client);
+            continue;
+          }
+          if(client.input.size() - offset < 5) {
+            break;
+          }
+          size_t length = static_cast<size_t>(read32(client.input.data() + offset + 1));
+          if(client.input.size() - offset < length + 1) {
+            break;
+          }
+          char type = client.input[offset];
+          std::string_view body(client.input.data() + offset + 5, length - 4);
+          offset += length + 1;
+          handle(client, type, body);
+        }
+        client.input.erase(0, offset);
+      }
+
+      void FakeServer::write(Client &client) {
+        while(!client.ready.empty()) {
+          ssize_t rc = send(client.fd, client.ready.data(), client.ready.size(), MSG_NOSIGNAL);
+          if(rc > 0) {
+            client.ready.erase(0, static_cast<size_t>(rc));
+            continue;
+          }
+          if(rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+          }
+          if(rc < 0 && errno == EINTR) {
+            continue;
+          }
+          client.isClosed = true;
+          return;
+        }
+      }
+
+      // replies are released after the configured latency, in order
+      void FakeServer::flush(Client &client) {
+        if(client.output.empty()) {
+          return;
+        }
+        std::chrono::steady_clock::duration delay = settings_.latency;
+        if(client.isSleeping) {
+          client.isSleeping = false;
+          delay += settings_.sleep;
+        }
+        if(delay.count() == 0 && client.delayed.empty()) {
+          client.ready.append(client.output);
+        } else {
+          client.delayed.emplace_back(std::chrono::steady_clock::now() + delay, std::move(client.output));
+        }
+        client.output.clear();
+      }
+
+      // the held replies are released at once, as if the sleeping query returned early
+      void FakeServer::cancel(int pid) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for(std::unique_ptr<Client> &client : clients_) {
+          if(client->pid != pid) {
+            continue;
+          }
+          for(std::pair<std::chrono::steady_clock::time_point, std::string> &delayed : client->delayed) {
+            delayed.first = std::min(delayed.first, now);
+          }
+        }
+      }
+
+      void FakeServer::handle(Client &client, char type, std::string_view body) {
+        if(client.isFailed && type != 'S') {
+          return;
+        }
+        switch(type) {
+          case 'P': {
+            std::string name(readString(body));
+            std::string_view query = readString(body);
+            if(contains(query, "MISSING_TABLE")) {
+              sendError(client, "relation \"missing_table\" does not exist", "42P01");
+              break;
+            }
+            Statement &statement = client.statements[name];
+            statement.parameterCount = countParameters(query);
+            statement.parameterTypes.assign(statement.parameterCount, TextOid);
+            statement.isDivisionByZero = contains(query, "1/0");
+            statement.isSleep = contains(query, "PG_SLEEP");
+            statement.isTerminate = contains(query, "PG_TERMINATE_BACKEND");
+            statement.listen = startsWith(query, "LISTEN ") || startsWith(query, "UNLISTEN ") ? std::string(query) : std::string();
+            if(body.size() >= 2) {
+              size_t count = static_cast<size_t>(read16(body.data()));
+              for(size_t i = 0; i < count && body.size() >= 6 + 4 * i; i++) {
+                uint32_t oid = static_cast<uint32_t>(read32(body.data() + 2 + 4 * i));
+                if(i >= statement.parameterTypes.size()) {
+                  statement.parameterTypes.resize(i + 1, TextOid);
+                }
+                if(oid != 0) {
+                  statement.parameterTypes[i] = oid;
+                }
+              }
+              statement.parameterCount = statement.parameterTypes.size();
+            }
+            Message(client.output, '1');
+            break;
+          }
+          case 'B': {
+            readString(body);
+            std::string name(readString(body));
+            if(client.statements.find(name) == client.statements.end()) {
+              sendError(client, "prepared statement does not exist");
+              break;
+            }
+            client.portalStatement = name;
+            size_t formatCount = static_cast<size_t>(read16(body.data()));
+            body.remove_prefix(2 + 2 * formatCount);
+            size_t parameterCount = static_cast<size_t>(read16(body.data()));
+            body.remove_prefix(2);
+            for(size_t i = 0; i < parameterCount; i++) {
+              int32_t length = read32(body.data());
+              body.remove_prefix(4 + (length > 0 ? static_cast<size_t>(length) : 0));
+            }
+            size_t resultFormatCount = static_cast<size_t>(read16(body.data()));
+            client.isBinaryResult = resultFormatCount > 0 && read16(body.data() + 2) == 1;
+            Message(client.output, '2');
+            break;
+          }
+          case 'D': {
+            char kind = body.empty() ? 'S' : body[0];
+            body.remove_prefix(1);
+            if(kind == 'S') {
+              std::unordered_map<std::string, Statement>::const_iterator i = client.statements.find(std::string(readString(body)));
+              if(i == client.statements.end()) {
+                sendError(client, "prepared statement does not exist");
+                break;
+              }
+              Message message(client.output, 't');
+              message.int16(static_cast<int16_t>(i->second.parameterTypes.size()));
+              for(uint32_t oid : i->second.parameterTypes) {
+                message.int32(static_cast<int32_t>(oid));
+              }
+            }
+            if(kind == 'P' && !client.statements[client.portalStatement].listen.empty()) {
+              Message(client.output, 'n');
+              break;
+            }
+            sendRowDescription(client, kind == 'P' && client.isBinaryResult);
+            break;
+          }
+          case 'E': {
+            const Statement &statement = client.statements[client.portalStatement];
+            if(!statement.listen.empty()) {
+              handleListen(client, statement.listen);
+              break;
+            }
+            size_t count = executeCount_.fetch_add(1, std::memory_order_relaxed) + 1;
+            if(settings_.disconnectEvery > 0 && count % settings_.disconnectEvery == 0) {
+              client.isClosed = true;
+              break;
+            }
+            if(statement.isTerminate) {
+              client.isClosed = true;
+              break;
+            }
+            // the error of a query failing after its sleep is held as well
+            client.isSleeping = statement.isSleep;
+            if(statement.isDivisionByZero) {
+              sendError(client, "division by zero", "22012");
+              break;
+            }
+            sendRows(client, client.isBinaryResult);
+            Message(client.output, 'C').string("SELECT " + std::to_string(settings_.rowCount));
+            break;
+          }
+          case 'C':
+            Message(client.output, '3');
+            break;
+          case 'S':
+            client.isFailed = false;
+            Message(client.output, 'Z').bytes("I");
+            flush(client);
+            break;
+          case 'H':
+            flush(client);
+            break;
+          case 'Q':
+            handleQuery(client, readString(body));
+            break;
+          case 'd':
+            if(client.isCopyIn) {
+              client.copyRows++;
+            }
+            break;
+          case 'c':
+            if(client.isCopyIn) {
+              client.isCopyIn = false;
+              Message(client.output, 'C').string("COPY " + std::to_string(client.copyRows));
+              Message(client.output, 'Z').bytes("I");
+              flush(client);
+            }
+            break;
+          case 'f':
+            if(client.isCopyIn) {
+              client.isCopyIn = false;
+              sendError(client, "COPY from stdin failed");
+              client.isFailed = false;
+              Message(client.output, 'Z').bytes("I");
+              flush(client);
+            }
+            break;
+          case 'X':
+            client.isClosed = true;
+            break;
+          default:
+            sendError(client, "unsupported message");
+            break;
+        }
+      }
+
+      void FakeServer::handleQuery(Client &client, std::string_view query) {
+        size_t begin = 0;
+        bool hasStatement = false;
+        while(begin < query.size()) {
+          size_t end = query.find(';', begin);
+          if(end == std::string_view::npos) {
+            end = query.size();
+          }
+          std::string_view statement = trim(query.substr(begin, end - begin));
+          begin = end + 1;
+          if(statement.empty()) {
+            continue;
+          }
+          hasStatement = true;
+          if(startsWith(statement, "LISTEN ") || startsWith(statement, "UNLISTEN ")) {
+            handleListen(client, statement);
+          } else if(startsWith(statement, "NOTIFY ")) {
+            std::string_view arguments = statement.substr(7);
+            size_t comma = arguments.find(',');
+            notify(unquote(arguments.substr(0, comma)), comma == std::string_view::npos ? std::string() : unquote(arguments.substr(comma + 1)), client.pid);
+            Message(client.output, 'C').string("NOTIFY");
+          } else if(startsWith(statement, "COPY ") && contains(statement, "FROM STDIN")) {
+            client.isCopyIn = true;
+            client.copyRows = 0;
+            Message(client.output, 'G').bytes(std::string(1, contains(statement, "BINARY") ? 1 : 0)).int16(0);
+            flush(client);
+            return;
+          } else if(startsWith(statement, "COPY ") && contains(statement, "TO STDOUT")) {
+            bool isBinary = contains(statement, "BINARY");
+            Message(client.output, 'H').bytes(std::string(1, isBinary ? 1 : 0)).int16(0);
+            if(isBinary) {
+              std::string header("PGCOPY\n\377\r\n\0", 11);
+              append32(header, 0);
+              append32(header, 0);
+              Message(client.output, 'd').bytes(header);
+            }
+            for(size_t i = 0; i < settings_.rowCount; i++) {
+              std::string row;
+              if(isBinary) {
+                append16(row, 3);
+                append32(row, 4);
+                append32(row, static_cast<int32_t>(i + 1));
+                append32(row, 16);
+                row.append(reinterpret_cast<const char *>(RowUuid), sizeof(RowUuid));
+                append32(row, static_cast<int32_t>(RowName.size()));
+                row.append(RowName);
+              } else {
+                row.append(std::to_string(i + 1)).append("\t").append(RowUuidText).append("\t").append(RowName).append("\n");
+              }
+              Message(client.output, 'd').bytes(row);
+            }
+            if(isBinary) {
+              std::string trailer;
+              append16(trailer, -1);
+              Message(client.output, 'd').bytes(trailer);
+            }
+            Message(client.output, 'c');
+            Message(client.output, 'C').string("COPY " + std::to_string(settings_.rowCount));
+          } else if(contains(statement, "PG_IS_IN_RECOVERY")) {
+            Message(client.output, 'T').int16(1).string("pg_is_in_recovery").int32(0).int16(0).int32(static_cast<int32_t>(BoolOid)).int16(1).int32(-1).int16(0);
+            Message(client.output, 'D').int16(1).int32(1).bytes("f");
+            Message(client.output, 'C').string("SELECT 1");
+          } else if(startsWith(statement, "SELECT")) {
+            executeCount_.fetch_add(1, std::memory_order_relaxed);
+            sendRowDescription(client, false);
+            sendRows(client, false);
+            Message(client.output, 'C').string("SELECT " + std::to_string(settings_.rowCount));
+          } else {
+            size_t space = statement.find(' ');
+            Message(client.output, 'C').string(std::string(statement.substr(0, space)));
+          }
+        }
+        if(!hasStatement) {
+          Message(client.output, 'I');
+        }
+        Message(client.output, 'Z').bytes("I");
+        flush(client);
+      }
+
+      void FakeServer::handleListen(Client &client, std::string_view statement) {
+        if(startsWith(statement, "LISTEN ")) {
+          client.channels.insert(unquote(statement.substr(7)));
+          Message(client.output, 'C').string("LISTEN");
+        } else {
+          client.channels.erase(unquote(statement.substr(9)));
+          Message(client.output, 'C').string("UNLISTEN");
+        }
+      }
+
+      void FakeServer::sendRowDescription(Client &client, bool isBinary) {
+        int16_t format = isBinary ? 1 : 0;
+        Message(client.output, 'T')
+            .int16(3)
+            .string("id")
+            .int32(0)
+            .int16(0)
+            .int32(static_cast<int32_t>(Int4Oid))
+            .int16(4)
+            .int32(-1)
+            .int16(format)
+            .string("group_id")
+            .int32(0)
+            .int16(0)
+            .int32(static_cast<int32_t>(UuidOid))
+            .int16(16)
+            .int32(-1)
+            .int16(format)
+            .string("name")
+            .int32(0)
+            .int16(0)
+            .int32(static_cast<int32_t>(TextOid))
+            .int16(-1)
+            .int32(-1)
+            .int16(format);
+      }
+
+      void FakeServer::sendRows(Client &client, bool isBinary) {
+        for(size_t i = 0; i < settings_.rowCount; i++) {
+          Message message(client.output, 'D');
+          message.int16(3);
+          if(isBinary) {
+            message.int32(4).int32(static_cast<int32_t>(i + 1));
+            message.int32(16).bytes(std::string_view(reinterpret_cast<const char *>(RowUuid), sizeof(RowUuid)));
+          } else {
+            std::string id = std::to_string(i + 1);
+            message.int32(static_cast<int32_t>(id.size())).bytes(id);
+            message.int32(static_cast<int32_t>(RowUuidText.size())).bytes(RowUuidText);
+          }
+          message.int32(static_cast<int32_t>(RowName.size())).bytes(RowName);
+        }
+      }
+
+      void FakeServer::sendError(Client &client, std::string_view message, std::string_view code) {
+        Message(client.output, 'E').bytes("S").string("ERROR").bytes("C").string(code).bytes("M").string(message).bytes(std::string_view("\0", 1));
+        client.isFailed = true;
+      }
+
+      void FakeServer::notify(std::string_view channel, std::string_view payload, int pid) {
+        for(std::unique_ptr<Client> &client : clients_) {
+          if(client->channels.count(std::string(channel)) != 0) {
+            Message(client->output, 'A').int32(pid).string(channel).string(payload);
+            flush(*client);
+          }
+        }
+      }
+
+    } // namespace postgresql
+  }   // namespace core
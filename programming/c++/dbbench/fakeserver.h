@@ -0,0 +1,113 @@
+#pragma once
+#include "core/common/error.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+  namespace core {
+    namespace postgresql {
+
+      // localhost server speaking enough of the v3 protocol to drive Connection without a real database:
+      // startup without authentication, Parse/Bind/Describe/Execute/Sync, simple queries, COPY in both
+      // directions and LISTEN/NOTIFY. Every query returns the same canned rows, a prepared statement with 1/0
+      // in its query fails with division_by_zero when executed. A query naming missing_table fails to prepare,
+      // pg_sleep holds the reply until a cancel request and pg_terminate_backend closes the connection. Runs on
+      // its own thread
+      class FakeServer {
+      public:
+        struct Settings {
+          uint16_t port = 0; // zero picks a free port
+          // added before the reply to every Sync and simple query
+          std::chrono::microseconds latency = {};
+          // rows of int4, uuid and text columns returned by every query and COPY TO
+          size_t rowCount = 1;
+          // connection is closed after this many executes, zero never
+          size_t disconnectEvery = 0;
+          // reply of a query calling pg_sleep is held this long unless the query is cancelled
+          std::chrono::milliseconds sleep = std::chrono::seconds(1);
+        };
+
+      public:
+        FakeServer() = default;
+        ~FakeServer();
+        FakeServer(const FakeServer &) = delete;
+        FakeServer &operator=(const FakeServer &) = delete;
+
+        Error start(const Settings &settings);
+        void stop();
+
+        uint16_t port() const;
+        size_t executeCount() const;
+
+      private:
+        struct Statement {
+          size_t parameterCount = 0;
+          std::vector<uint32_t> parameterTypes;
+          bool isDivisionByZero = false;
+          bool isSleep = false;
+          bool isTerminate = false;
+          // LISTEN or UNLISTEN sent with the extended protocol
+          std::string listen;
+        };
+
+        struct Client {
+          int fd = -1;
+          int pid = 0;
+          bool isStarted = false;
+          bool isCopyIn = false;
+          bool isFailed = false; // extended protocol messages are skipped until Sync
+          bool isClosed = false;
+          bool isSleeping = false; // the next flush is held for Settings::sleep
+          size_t copyRows = 0;
+          bool isBinaryResult = false;
+          std::string portalStatement;
+          std::string input;
+          std::string output;
+          std::string ready;
+          std::deque<std::pair<std::chrono::steady_clock::time_point, std::string>> delayed;
+          std::unordered_map<std::string, Statement> statements;
+          std::set<std::string> channels;
+        };
+
+        void run();
+        void accept();
+        void read(Client &client);
+        void write(Client &client);
+        void handle(Client &client, char type, std::string_view body);
+        void handleQuery(Client &client, std::string_view query);
+        void handleListen(Client &client, std::string_view statement);
+        void flush(Client &client);
+        void cancel(int pid);
+
+        void sendRowDescription(Client &client, bool isBinary);
+        void sendRows(Client &client, bool isBinary);
+        void sendError(Client &client, std::string_view message, std::string_view code = "XX000");
+        void notify(std::string_view channel, std::string_view payload, int pid);
+
+      private:
+        Settings settings_;
+        int listenFd_ = -1;
+        int wakeFds_[2] = {-1, -1};
+        uint16_t port_ = 0;
+        std::thread thread_;
+        std::vector<std::unique_ptr<Client>> clients_;
+        int nextPid_ = 1000;
+        std::atomic<size_t> executeCount_ = 0;
+      };
+
+      inline uint16_t FakeServer::port() const {
+        return port_;
+      }
+      inline size_t FakeServer::executeCount() const {
+        return executeCount_.load(std::memory_order_relaxed);
+      }
+
+    } // namespace postgresql
+  }   // namespace core
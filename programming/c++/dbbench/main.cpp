@@ -0,0 +1,284 @@
+#include "connection.h"
+#include "recordset.h"
+#include "statementregistry.h"
+#include "core/microservice/eventloop.h"
+#include "fakeserver.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// client side cost of Connection measured against FakeServer: queries per second, latency percentiles
+// and heap allocations per query on the event loop thread
+//
+//   dbbench --mode=typed --queries=1000000 --depth=16 --latency=0 --rows=1 --disconnect-every=0
+//
+// copy can't be pipelined, --mode=copyto always runs with depth 1
+
+namespace {
+  thread_local size_t allocationCount = 0;
+}
+
+void *operator new(size_t size) {
+  allocationCount++;
+  if(void *p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  std::free(p);
+}
+
+  namespace core {
+    namespace postgresql {
+
+      namespace {
+        enum class Mode { Typed, Prepared, CopyTo };
+
+        struct Arguments {
+          Mode mode = Mode::Typed;
+          size_t queries = 100000;
+          // requests kept in flight on the connection
+          size_t depth = 16;
+          FakeServer::Settings server;
+        };
+
+        bool parseArguments(int argc, char **argv, Arguments &arguments) {
+          for(int i = 1; i < argc; i++) {
+            std::string_view argument = argv[i];
+            size_t equal = argument.find('=');
+            std::string_view name = argument.substr(0, equal);
+            std::string value(equal == std::string_view::npos ? std::string_view() : argument.substr(equal + 1));
+            if(name == "--mode") {
+              if(value == "typed") {
+                arguments.mode = Mode::Typed;
+              } else if(value == "prepared") {
+                arguments.mode = Mode::Prepared;
+              } else if(value == "copyto") {
+                arguments.mode = Mode::CopyTo;
+              } else {
+                return false;
+              }
+            } else if(name == "--queries") {
+              arguments.queries = std::strtoull(value.c_str(), nullptr, 10);
+            } else if(name == "--depth") {
+              arguments.depth = std::max<size_t>(1, std::strtoull(value.c_str(), nullptr, 10));
+            } else if(name == "--latency") {
+              arguments.server.latency = std::chrono::microseconds(std::strtoull(value.c_str(), nullptr, 10));
+            } else if(name == "--rows") {
+              arguments.server.rowCount = std::strtoull(value.c_str(), nullptr, 10);
+            } else if(name == "--disconnect-every") {
+              arguments.server.disconnectEvery = std::strtoull(value.c_str(), nullptr, 10);
+            } else {
+              return false;
+            }
+          }
+          if(arguments.mode == Mode::CopyTo) {
+            arguments.depth = 1;
+          }
+          return arguments.queries > 0;
+        }
+
+        class Benchmark {
+        public:
+          Benchmark(EventLoop *eventLoop, const Arguments &arguments) :
+              eventLoop_(eventLoop), arguments_(arguments), connection_(CONSTRUCT_ASYNC_OBJECT("Benchmark::connection_"), eventLoop),
+              statement_(StatementRegistry::instance()->declare<int32_t>("dbbench_typed", "select id, group_id, name from members where id > $1")) {
+            latencies_.reserve(arguments_.queries);
+            sendTimes_.resize(arguments_.depth);
+            for(size_t i = arguments_.depth; i > 0; i--) {
+              freeSlots_.push_back(i - 1);
+            }
+          }
+
+          Error initialize(const Options &options) {
+            connection_->setMaxPipelineDepth(arguments_.depth);
+            return connection_->initialize(
+                1,
+                options,
+                0,
+                [this]() -> Error {
+                  onConnected();
+                  return Error::Success;
+                },
+                [this](const Error &) {
+                  isConnected_ = false;
+                  disconnectCount_++;
+                });
+          }
+
+          bool isDone() const {
+            return completedCount_ + failedCount_ >= arguments_.queries;
+          }
+
+          void report() const {
+            std::chrono::duration<double> elapsed = finishTime_ - startTime_;
+            std::vector<int64_t> latencies = latencies_;
+            std::sort(latencies.begin(), latencies.end());
+            auto percentile = [&latencies](double p) -> double {
+              if(latencies.empty()) {
+                return 0;
+              }
+              size_t index = std::min(latencies.size() - 1, static_cast<size_t>(p * static_cast<double>(latencies.size())));
+              return static_cast<double>(latencies[index]) / 1000.0;
+            };
+            std::printf("queries      %zu completed, %zu failed, %zu disconnects\n", completedCount_, failedCount_, disconnectCount_);
+            std::printf("throughput   %.0f queries/s\n", static_cast<double>(completedCount_) / elapsed.count());
+            std::printf("latency      p50 %.1f us, p99 %.1f us, max %.1f us\n", percentile(0.5), percentile(0.99), percentile(1.0));
+            std::printf("allocations  %.2f per query\n", completedCount_ ? static_cast<double>(allocations_) / static_cast<double>(completedCount_) : 0.0);
+          }
+
+        private:
+          void onConnected() {
+            isConnected_ = true;
+            if(startTime_ == std::chrono::steady_clock::time_point()) {
+              startTime_ = std::chrono::steady_clock::now();
+              allocations_ = 0;
+              allocationStart_ = allocationCount;
+            }
+            if(arguments_.mode != Mode::Prepared) {
+              pump();
+              return;
+            }
+            // statements prepared by name do not survive a reconnect
+            connection_->prepare("dbbench_prepared", "select id, group_id, name from members", nullptr, [this](const Error &error, const AsyncObjectPtr<Connection> &) {
+              if(error.isFail()) {
+                std::fprintf(stderr, "Unable to prepare statement. %s\n", error.message());
+                return;
+              }
+              pump();
+            });
+          }
+
+          // a request failing before it is sent completes inside the loop, the loop stops then instead of
+          // burning the remaining queries, the connected handler starts it again
+          void pump() {
+            if(isPumping_) {
+              return;
+            }
+            isPumping_ = true;
+            isSendFailed_ = false;
+            while(isConnected_ && !isSendFailed_ && !freeSlots_.empty() && sentCount_ < arguments_.queries) {
+              size_t slot = freeSlots_.back();
+              freeSlots_.pop_back();
+              sentCount_++;
+              sendTimes_[slot] = std::chrono::steady_clock::now();
+              ExecuteHandler handler = [this, slot](const Error &error, Recordset &&, const AsyncObjectPtr<Connection> &) {
+                complete(slot, error);
+              };
+              switch(arguments_.mode) {
+                case Mode::Typed:
+                  connection_->execute(statement_, std::move(handler), sentCount_, static_cast<int32_t>(sentCount_));
+                  break;
+                case Mode::Prepared:
+                  connection_->execute("dbbench_prepared", nullptr, std::move(handler), sentCount_);
+                  break;
+                case Mode::CopyTo:
+                  connection_->copyTo(
+                      "COPY members TO STDOUT (FORMAT binary)",
+                      [this](std::string_view data, const AsyncObjectPtr<Connection> &) {
+                        copiedBytes_ += data.size();
+                      },
+                      std::move(handler),
+                      sentCount_);
+                  break;
+              }
+            }
+            isPumping_ = false;
+          }
+
+          void complete(size_t slot, const Error &error) {
+            freeSlots_.push_back(slot);
+            if(error.isFail()) {
+              failedCount_++;
+              isSendFailed_ = isPumping_;
+            } else {
+              completedCount_++;
+              latencies_.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - sendTimes_[slot]).count());
+            }
+            if(isDone()) {
+              if(finishTime_ == std::chrono::steady_clock::time_point()) {
+                finishTime_ = std::chrono::steady_clock::now();
+                allocations_ = allocationCount - allocationStart_;
+                connection_->destroy();
+                eventLoop_->stop();
+              }
+              return;
+            }
+            // a failed query frees its slot as well, a send failing again stops the loop in pump.
+            // After a disconnect the connected handler sends the next requests
+            if(isConnected_) {
+              pump();
+            }
+          }
+
+        private:
+          EventLoop *eventLoop_;
+          const Arguments &arguments_;
+          AsyncObjectPtr<Connection> connection_;
+          TypedStatementId<int32_t> statement_;
+          bool isConnected_ = false;
+          bool isPumping_ = false;
+          bool isSendFailed_ = false;
+          std::vector<size_t> freeSlots_;
+          std::vector<std::chrono::steady_clock::time_point> sendTimes_;
+          std::vector<int64_t> latencies_;
+          size_t sentCount_ = 0;
+          size_t completedCount_ = 0;
+          size_t failedCount_ = 0;
+          size_t disconnectCount_ = 0;
+          size_t copiedBytes_ = 0;
+          size_t allocationStart_ = 0;
+          size_t allocations_ = 0;
+          std::chrono::steady_clock::time_point startTime_;
+          std::chrono::steady_clock::time_point finishTime_;
+        };
+      } // namespace
+
+    } // namespace postgresql
+  }   // namespace core
+
+int main(int argc, char **argv) {
+  using namespace core::postgresql;
+  Arguments arguments;
+  if(!parseArguments(argc, argv, arguments)) {
+    std::fprintf(stderr, "usage: %s [--mode=typed|prepared|copyto] [--queries=N] [--depth=N] [--latency=us] [--rows=N] [--disconnect-every=N]\n", argv[0]);
+    return 1;
+  }
+  FakeServer server;
+  Error error = server.start(arguments.server);
+  if(error.isFail()) {
+    std::fprintf(stderr, "%s\n", error.message());
+    return 1;
+  }
+  EventLoop eventLoop;
+  error = eventLoop.initialize();
+  if(error.isFail()) {
+    std::fprintf(stderr, "%s\n", error.message());
+    return 1;
+  }
+  Options options;
+  options.setHosts({"127.0.0.1"});
+  options.setPort(server.port());
+  options.setDatabaseName("dbbench");
+  options.setUserName("dbbench");
+  options.setAutoReconnect(true);
+  options.setReconnectInterval(std::chrono::milliseconds(1));
+  Benchmark benchmark(&eventLoop, arguments);
+  error = benchmark.initialize(options);
+  if(error.isFail()) {
+    std::fprintf(stderr, "%s\n", error.message());
+    return 1;
+  }
+  eventLoop.run();
+  benchmark.report();
+  server.stop();
+  return benchmark.isDone() ? 0 : 1;
+}
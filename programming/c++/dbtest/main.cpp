@@ -0,0 +1,548 @@
+#include "binarycopy.h"
+#include "connection.h"
+#include "connectionpool.h"
+#include "recordset.h"
+#include "core/microservice/eventloop.h"
+#include "fakeserver.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// behaviour of Connection checked against FakeServer from dbbench, built the same way. Every test runs on
+// its own connection and stops the event loop when it is done, the first failure reported is kept
+//
+//   dbtest
+
+  namespace core {
+    namespace postgresql {
+
+      namespace {
+        struct Test {
+          const char *name;
+          std::function<void(const AsyncObjectPtr<Connection> &connection, std::function<void(const char *failure)> &&done)> run;
+        };
+
+        // handler runs once the condition holds, it is checked every 10 ms
+        void waitFor(Timer *timer, std::function<bool()> &&condition, std::function<void()> &&handler) {
+          if(condition()) {
+            handler();
+            return;
+          }
+          timer->restart(std::chrono::milliseconds(10), [timer, condition = std::move(condition), handler = std::move(handler)]() {
+            waitFor(timer, std::function<bool()>(condition), std::function<void()>(handler));
+          });
+        }
+
+        // the reply of an abandoned request is dropped, the next request gets its own result
+        void checkUsable(const AsyncObjectPtr<Connection> &connection, const AsyncObjectPtr<Timer> &timer, const std::function<void(const char *failure)> &done) {
+          waitFor(
+              timer.get(),
+              [connection]() {
+                return !connection->isBusy();
+              },
+              [connection, done]() {
+                connection->execute(
+                    "dbtest_ok",
+                    nullptr,
+                    [done](const Error &error, Recordset &&result, const AsyncObjectPtr<Connection> &) {
+                      if(error.isFail()) {
+                        done("reply of the abandoned request reached the next one");
+                      } else if(PQntuples(result.handle()) != 1) {
+                        done("rows of the next request are lost");
+                      } else {
+                        done(nullptr);
+                      }
+                    },
+                    2);
+              });
+        }
+
+        Error prepareTestStatements(const AsyncObjectPtr<Connection> &connection) {
+          // the reply of the sleeping query is an error, a request getting it by mistake fails
+          for(std::pair<const char *, const char *> statement : {std::pair("dbtest_ok", "select id, group_id, name from members"),
+                                                                 std::pair("dbtest_fail", "select 1/0"),
+                                                                 std::pair("dbtest_sleep", "select pg_sleep(1), 1/0")}) {
+            Error error = connection->prepare(statement.first, statement.second);
+            if(error.isFail()) {
+              return error;
+            }
+          }
+          return Error::Success;
+        }
+
+        // results of pipelined requests reach their handlers in order, a failed request does not abort the ones after it
+        // and a request refused while the pipeline is full takes no place in it
+        void pipelineOrder(const AsyncObjectPtr<Connection> &connection, std::function<void(const char *failure)> &&done) {
+          if(prepareTestStatements(connection).isFail()) {
+            done("prepare failed");
+            return;
+          }
+          std::shared_ptr<std::vector<size_t>> order = std::make_shared<std::vector<size_t>>();
+          const char *names[] = {"dbtest_ok", "dbtest_fail", "dbtest_ok", "dbtest_ok"};
+          for(size_t i = 0; i < std::size(names); i++) {
+            connection->execute(
+                names[i],
+                nullptr,
+                [order, i, done](const Error &error, Recordset &&result, const AsyncObjectPtr<Connection> &) {
+                  order->push_back(i);
+                  if(error.isFail() != (i == 1)) {
+                    done("result reached another handler");
+                  } else if(error.isSuccess() && PQntuples(result.handle()) != 1) {
+                    done("rows of the request are lost");
+                  } else if(i == 3) {
+                    done(*order == std::vector<size_t>{0, 1, 2, 3} ? nullptr : "handlers are called out of order");
+                  }
+                },
+                i + 1);
+          }
+          std::shared_ptr<bool> isRefused = std::make_shared<bool>(false);
+          connection->execute(
+              "dbtest_ok",
+              nullptr,
+              [isRefused](const Error &error, Recordset &&, const AsyncObjectPtr<Connection> &) {
+                *isRefused = error.isFail() && std::strstr(error.message(), "busy") != nullptr;
+              },
+              std::size(names) + 1);
+          if(!*isRefused) {
+            done("request beyond the pipeline depth is not refused");
+          }
+        }
+
+        // the pool queues requests until its connections are ready, a statement the server rejects is reported once and
+        // dropped instead of reconnecting
+        void pool(const AsyncObjectPtr<Connection> &connection, std::function<void(const char *failure)> &&done) {
+          AsyncObjectPtr<ConnectionPool> pool(CONSTRUCT_ASYNC_OBJECT("dbtest::pool"), connection->eventLoop());
+          ConnectionPool::Settings settings;
+          settings.minSize = 2;
+          settings.maxSize = 2;
+          Error error = pool->initialize(connection->options(), settings);
+          if(error.isFail()) {
+            done("pool is not initialized");
+            return;
+          }
+          std::shared_ptr<size_t> rejectedCount = std::make_shared<size_t>(0);
+          pool->addPreparedStatement("dbtest_pool", "select id, group_id, name from members");
+          pool->addPreparedStatement("dbtest_missing", "select id from missing_table", nullptr, [rejectedCount](const Error &) {
+            (*rejectedCount)++;
+          });
+          std::shared_ptr<size_t> completedCount = std::make_shared<size_t>(0);
+          for(size_t i = 0; i < 4; i++) {
+            pool->execute(
+                "dbtest_pool",
+                nullptr,
+                [pool, rejectedCount, completedCount, done](const Error &error, Recordset &&result, const AsyncObjectPtr<Connection> &) {
+                  const char *failure = nullptr;
+                  if(error.isFail()) {
+                    failure = "request failed";
+                  } else if(PQntuples(result.handle()) != 1) {
+                    failure = "rows of the request are lost";
+                  } else if(++*completedCount < 4) {
+                    return;
+                  } else if(*rejectedCount != 1) {
+                    failure = "rejected statement is not reported once";
+                  } else if(pool->size() != 2) {
+                    failure = "connections of the pool are lost";
+                  }
+                  std::function<void(const char *failure)> finish = done;
+                  AsyncObjectPtr<ConnectionPool> destroyed = pool;
+                  destroyed->destroy();
+                  finish(failure);
+                },
+                i + 1);
+          }
+        }
+
+        // copy data is taken from the handler until it returns none, the server counts every row
+        void copyIn(const AsyncObjectPtr<Connection> &connection, std::function<void(const char *failure)> &&done) {
+          std::shared_ptr<size_t> sentCount = std::make_shared<size_t>(0);
+          connection->copyFrom(
+              "COPY members FROM STDIN",
+              [sentCount](std::string_view &data) -> Error {
+                static constexpr std::string_view Row = "1\t6ba7b810-9dad-11d1-80b4-00c04fd430c8\tmember\n";
+                if(*sentCount < 3) {
+                  data = Row;
+                  (*sentCount)++;
+                } else {
+                  data = {};
+                }
+                return Error::Success;
+              },
+              [done](const Error &error, Recordset &&result, const AsyncObjectPtr<Connection> &) {
+                if(error.isFail()) {
+                  done("copy failed");
+                } else if(std::strcmp(PQcmdTuples(result.handle()), "3") != 0) {
+                  done("rows of the copy are lost");
+                } else {
+                  done(nullptr);
+                }
+              },
+              1);
+        }
+
+        // binary copy rows come one by one and decode into the fields of the row
+        void copyOut(const AsyncObjectPtr<Connection> &connection, std::function<void(const char *failure)> &&done) {
+          struct State {
+            BinaryCopyReader reader;
+            std::vector<BinaryCopyReader::Field> fields;
+            size_t rowCount = 0;
+            bool isEnd = false;
+            const char *failure = nullptr;
+          };
+          std::shared_ptr<State> state = std::make_shared<State>();
+          connection->copyTo(
+              "COPY members TO STDOUT (FORMAT binary)",
+              [state](std::string_view data, const AsyncObjectPtr<Connection> &) {
+                if(state->failure) {
+                  return;
+                }
+                if(state->reader.read(data, state->fields, state->isEnd).isFail()) {
+                  state->failure = "copy data is not parsed";
+                  return;
+                }
+                if(state->fields.empty()) {
+                  return;
+                }
+                state->rowCount++;
+                if(state->fields.size() != 3 || state->fields[0].toInt32() != 1 || state->fields[2].toString() != "member") {
+                  state->failure = "fields of the row are wrong";
+                }
+              },
+              [state, done](const Error &error, Recordset &&, const AsyncObjectPtr<Connection> &) {
+                if(error.isFail()) {
+                  done("copy failed");
+                } else if(state->failure) {
+                  done(state->failure);
+                } else if(state->rowCount != 1 || !state->isEnd) {
+                  done("rows of the copy are lost");
+                } else {
+                  done(nullptr);
+                }
+              },
+              1);
+        }
+
+        // a request outliving its deadline completes at once and the connection takes the next request
+        void requestTimeout(const AsyncObjectPtr<Connection> &connection, std::function<void(const char *failure)> &&done) {
+          if(prepareTestStatements(connection).isFail()) {
+            done("prepare failed");
+            return;
+          }
+          AsyncObjectPtr<Timer> timer(CONSTRUCT_ASYNC_OBJECT("dbtest::timer"), connection->eventLoop());
+          std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+          connection->execute(
+              "dbtest_sleep",
+              nullptr,
+              [connection, timer, start, done](const Error &error, Recordset &&, const AsyncObjectPtr<Connection> &) {
+                if(error.isSuccess() || std::strstr(error.message(), "timeout") == nullptr) {
+                  done("request is not timed out");
+                } else if(std::chrono::steady_clock::now() - start > std::chrono::milliseconds(500)) {
+                  done("request outlived its deadline");
+                } else {
+                  checkUsable(connection, timer, done);
+                }
+              },
+              1,
+              std::chrono::milliseconds(50));
+        }
+
+        // a cancelled request completes at once with its own error, only a request in flight is found
+        void cancel(const AsyncObjectPtr<Connection> &connection, std::function<void(const char *failure)> &&done) {
+          if(prepareTestStatements(connection).isFail()) {
+            done("prepare failed");
+            return;
+          }
+          AsyncObjectPtr<Timer> timer(CONSTRUCT_ASYNC_OBJECT("dbtest::timer"), connection->eventLoop());
+          connection->execute(
+              "dbtest_sleep",
+              nullptr,
+              [connection, timer, done](const Error &error, Recordset &&, const AsyncObjectPtr<Connection> &) {
+                if(error.isSuccess() || std::strstr(error.message(), "cancelled") == nullptr) {
+                  done("request is not cancelled");
+                } else {
+                  checkUsable(connection, timer, done);
+                }
+              },
+              1);
+          if(connection->cancel(3)) {
+            done("unknown request is cancelled");
+          } else if(!connection->cancel(1)) {
+            done("request in flight is not found");
+          }
+        }
+
+        // a registry statement is prepared by its first execute and its described parameter types are kept. Declaring the
+        // name again with another query is refused, a statement the server rejects fails only its own request
+        void lazyPrepare(const AsyncObjectPtr<Connection> &connection, std::function<void(const char *failure)> &&done) {
+          StatementRegistry *registry = StatementRegistry::instance();
+          StatementId id = registry->declare("dbtest_lazy", "select id, group_id, name from members");
+          if(id == InvalidStatementId || registry->declare("dbtest_lazy", "select id, group_id, name from members") != id) {
+            done("statement declared again is not the same one");
+            return;
+          }
+          if(registry->declare("dbtest_lazy", "select 1") != InvalidStatementId) {
+            done("statement declared again with another query is accepted");
+            return;
+          }
+          std::shared_ptr<bool> isRejected = std::make_shared<bool>(false);
+          connection->execute(
+              registry->declare("dbtest_lazy_missing", "select id from missing_table"),
+              nullptr,
+              [isRejected](const Error &error, Recordset &&, const AsyncObjectPtr<Connection> &) {
+                *isRejected = error.isFail() && std::strstr(error.message(), "does not exist") != nullptr;
+              },
+              1);
+          connection->execute(
+              id,
+              nullptr,
+              [registry, id, isRejected, done](const Error &error, Recordset &&result, const AsyncObjectPtr<Connection> &) {
+                if(!*isRejected) {
+                  done("error of the rejected statement is lost");
+                } else if(error.isFail()) {
+                  done("lazy prepare failed");
+                } else if(PQntuples(result.handle()) != 1) {
+                  done("rows of the request are lost");
+                } else if(!registry->statement(id).isDescribed) {
+                  done("parameter types are not kept");
+                } else {
+                  done(nullptr);
+                }
+              },
+              2);
+        }
+
+        // a lost connection is reset in place without waiting for the reconnect backoff and takes requests again
+        void reset(const AsyncObjectPtr<Connection> &connection, std::function<void(const char *failure)> &&done) {
+          AsyncObjectPtr<Timer> timer(CONSTRUCT_ASYNC_OBJECT("dbtest::timer"), connection->eventLoop());
+          std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+          connection->executeQuery(
+              "select pg_terminate_backend(pg_backend_pid())",
+              nullptr,
+              [connection, timer, start, done](const Error &error, Recordset &&, const AsyncObjectPtr<Connection> &) {
+                if(error.isSuccess()) {
+                  done("backend is not terminated");
+                  return;
+                }
+                waitFor(
+                    timer.get(),
+                    [connection]() {
+                      return connection->isValid();
+                    },
+                    [connection, start, done]() {
+                      if(std::chrono::steady_clock::now() - start >= connection->options().reconnectInterval() / 2) {
+                        done("connection waited for the reconnect backoff");
+                        return;
+                      }
+                      connection->executeQuery(
+                          "select id, group_id, name from members",
+                          nullptr,
+                          [done](const Error &error, Recordset &&, const AsyncObjectPtr<Connection> &) {
+                            done(error.isSuccess() ? nullptr : "reset connection is not usable");
+                          },
+                          2);
+                    });
+              },
+              1);
+        }
+
+        // every failed attempt doubles the reconnect delay, the jitter keeps each one within the upper half
+        void backoff(const AsyncObjectPtr<Connection> &connection, std::function<void(const char *failure)> &&done) {
+          FakeServer closed;
+          if(closed.start({}).isFail()) {
+            done("server is not started");
+            return;
+          }
+          Options options = connection->options();
+          options.setPort(closed.port());
+          options.setReconnectInterval(std::chrono::milliseconds(20));
+          closed.stop();
+          AsyncObjectPtr<Connection> lost(CONSTRUCT_ASYNC_OBJECT("dbtest::lost"), connection->eventLoop());
+          std::shared_ptr<std::vector<std::chrono::steady_clock::time_point>> failures = std::make_shared<std::vector<std::chrono::steady_clock::time_point>>();
+          Error error = lost->initialize(
+              2,
+              options,
+              0,
+              []() -> Error {
+                return Error::Success;
+              },
+              [lost, failures, done](const Error &) {
+                failures->push_back(std::chrono::steady_clock::now());
+                if(failures->size() < 5) {
+                  return;
+                }
+                const char *failure = nullptr;
+                for(size_t i = 1; i < failures->size(); i++) {
+                  if((*failures)[i] - (*failures)[i - 1] < std::chrono::milliseconds(10) * (int64_t(1) << (i - 1))) {
+                    failure = "reconnect attempt came before its backoff";
+                  }
+                }
+                std::function<void(const char *failure)> finish = done;
+                AsyncObjectPtr<Connection> destroyed = lost;
+                destroyed->destroy();
+                finish(failure);
+              });
+          if(error.isFail()) {
+            done("connection is not initialized");
+          }
+        }
+
+        void sendNotify(const AsyncObjectPtr<Connection> &connection, const AsyncObjectPtr<Timer> &timer, const std::function<void(const char *failure)> &done) {
+          // a pending LISTEN holds the exclusive request back
+          waitFor(
+              timer.get(),
+              [connection]() {
+                return connection->isValid() && connection->pendingRequestCount() == 0;
+              },
+              [connection, done]() {
+                connection->executeMulti(
+                    "NOTIFY dbtest_channel, 'hello'",
+                    [done](const Error &error, std::vector<Recordset> &&, const AsyncObjectPtr<Connection> &) {
+                      if(error.isFail()) {
+                        done("notify failed");
+                      }
+                    },
+                    InvalidRequestId);
+              });
+        }
+
+        // notifications reach the subscriber, the subscription is sent again after the connection is reset
+        void notify(const AsyncObjectPtr<Connection> &connection, std::function<void(const char *failure)> &&done) {
+          AsyncObjectPtr<Timer> timer(CONSTRUCT_ASYNC_OBJECT("dbtest::timer"), connection->eventLoop());
+          std::shared_ptr<size_t> count = std::make_shared<size_t>(0);
+          connection->subscribe(
+              "dbtest_channel",
+              [timer, count, done](std::string_view channel, std::string_view payload, const AsyncObjectPtr<Connection> &connection) {
+                if(channel != "dbtest_channel" || payload != "hello") {
+                  done("notification is garbled");
+                  return;
+                }
+                if(++*count == 2) {
+                  done(nullptr);
+                  return;
+                }
+                connection->executeQuery(
+                    "select pg_terminate_backend(pg_backend_pid())",
+                    nullptr,
+                    [connection = AsyncObjectPtr<Connection>(connection), timer, done](const Error &, Recordset &&, const AsyncObjectPtr<Connection> &) {
+                      sendNotify(connection, timer, done);
+                    },
+                    1);
+              });
+          sendNotify(connection, timer, done);
+        }
+
+        // the error of the failed batch query reaches the handler, it is not replaced by the aborted queries after it
+        void batchFailure(const AsyncObjectPtr<Connection> &connection, std::function<void(const char *failure)> &&done) {
+          connection->prepare("dbtest_ok", "select id, group_id, name from members", nullptr, [](const Error &, const AsyncObjectPtr<Connection> &) {
+          });
+          connection->prepare("dbtest_fail", "select 1/0", nullptr, [](const Error &, const AsyncObjectPtr<Connection> &) {
+          });
+          connection->executeBatch(
+              {{"dbtest_ok", nullptr}, {"dbtest_fail", nullptr}, {"dbtest_ok", nullptr}},
+              [done = std::move(done)](const Error &error, std::vector<Recordset> &&results, const AsyncObjectPtr<Connection> &) {
+                if(error.isSuccess()) {
+                  done("batch succeeded");
+                } else if(std::strstr(error.message(), "division by zero") == nullptr) {
+                  done("error message of the failed query is lost");
+                } else if(results.size() != 2) {
+                  done("results of the batch are not the ones up to the failed query");
+                } else if(PQresultStatus(results[0].handle()) != PGRES_TUPLES_OK) {
+                  done("first query failed");
+                } else if(const char *state = PQresultErrorField(results[1].handle(), PG_DIAG_SQLSTATE); state == nullptr || std::strcmp(state, "22012") != 0) {
+                  done("SQLSTATE of the failed query is lost");
+                } else {
+                  done(nullptr);
+                }
+              },
+              InvalidRequestId);
+        }
+
+        bool runTest(const Test &test, const Options &options) {
+          EventLoop eventLoop;
+          Error error = eventLoop.initialize();
+          if(error.isFail()) {
+            std::printf("%-24s %s\n", test.name, error.message());
+            return false;
+          }
+          const char *failure = "not completed";
+          bool isDone = false;
+          bool isStarted = false;
+          AsyncObjectPtr<Connection> connection(CONSTRUCT_ASYNC_OBJECT("dbtest::connection"), &eventLoop);
+          connection->setMaxPipelineDepth(4);
+          error = connection->initialize(
+              1,
+              options,
+              0,
+              [&]() -> Error {
+                // called again after a reconnect
+                if(isStarted) {
+                  return Error::Success;
+                }
+                isStarted = true;
+                test.run(connection, [&](const char *result) {
+                  if(isDone) {
+                    return;
+                  }
+                  isDone = true;
+                  failure = result;
+                  eventLoop.stop();
+                });
+                return Error::Success;
+              },
+              [](const Error &) {
+              });
+          if(error.isFail()) {
+            std::printf("%-24s %s\n", test.name, error.message());
+            return false;
+          }
+          eventLoop.run();
+          connection->destroy();
+          std::printf("%-24s %s\n", test.name, failure ? failure : "ok");
+          return failure == nullptr;
+        }
+      } // namespace
+
+    } // namespace postgresql
+  }   // namespace core
+
+int main() {
+  using namespace core::postgresql;
+  FakeServer server;
+  Error error = server.start({});
+  if(error.isFail()) {
+    std::fprintf(stderr, "%s\n", error.message());
+    return 1;
+  }
+  Options options;
+  options.setHosts({"127.0.0.1"});
+  options.setPort(server.port());
+  options.setDatabaseName("dbtest");
+  options.setUserName("dbtest");
+  options.setAutoReconnect(true);
+  // the reset test tells the in place reset from the reconnect by this delay
+  options.setReconnectInterval(std::chrono::seconds(1));
+
+  const Test tests[] = {
+      {"pipeline order", pipelineOrder},
+      {"batch failure", batchFailure},
+      {"pool", pool},
+      {"copy in", copyIn},
+      {"copy out", copyOut},
+      {"request timeout", requestTimeout},
+      {"cancel", cancel},
+      {"lazy prepare", lazyPrepare},
+      {"reset", reset},
+      {"reconnect backoff", backoff},
+      {"notify", notify},
+  };
+  size_t failed = 0;
+  for(const Test &test : tests) {
+    if(!runTest(test, options)) {
+      failed++;
+    }
+  }
+  server.stop();
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+#include "dnscache.h"
+#include <algorithm>
+
+  namespace core {
+    namespace postgresql {
+
+      DnsCache *DnsCache::instance() {
+        static DnsCache cache;
+        return &cache;
+      }
+
+      bool DnsCache::get(std::string_view host, std::vector<std::string> &addresses) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unordered_map<std::string, Entry>::iterator i = entries_.find(std::string(host));
+        if(i == entries_.end()) {
+          return false;
+        }
+        if(i->second.expires <= std::chrono::steady_clock::now()) {
+          entries_.erase(i);
+          return false;
+        }
+        addresses = i->second.addresses;
+        if(!i->second.connected.empty()) {
+          std::vector<std::string>::iterator connected = std::find(addresses.begin(), addresses.end(), i->second.connected);
+          if(connected != addresses.end()) {
+            std::rotate(addresses.begin(), connected, connected + 1);
+          }
+        }
+        return true;
+      }
+
+      void DnsCache::put(std::string_view host, std::vector<std::string> &&addresses) {
+        if(addresses.empty()) {
+          return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry &entry = entries_[std::string(host)];
+        entry.addresses = std::move(addresses);
+        entry.expires = std::chrono::steady_clock::now() + ttl_;
+      }
+
+      void DnsCache::setConnected(std::string_view host, std::string_view address) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unordered_map<std::string, Entry>::iterator i = entries_.find(std::string(host));
+        if(i != entries_.end()) {
+          i->second.connected = address;
+        }
+      }
+
+      void DnsCache::invalidate(std::string_view host) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.erase(std::string(host));
+      }
+
+      void DnsCache::setTtl(std::chrono::seconds ttl) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ttl_ = ttl;
+      }
+
+    } // namespace postgresql
+  }   // namespace core
@@ -0,0 +1,40 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+  namespace core {
+    namespace postgresql {
+
+      // resolved database host addresses shared by all connections of the process, so reconnects do not
+      // resolve the same host again. The address of the last successful connect is returned first
+      class DnsCache {
+      public:
+        static DnsCache *instance();
+
+        // returns false when the host is not cached or the entry is expired
+        bool get(std::string_view host, std::vector<std::string> &addresses);
+        void put(std::string_view host, std::vector<std::string> &&addresses);
+        void setConnected(std::string_view host, std::string_view address);
+        // all addresses failed, the host is resolved again next time
+        void invalidate(std::string_view host);
+
+        void setTtl(std::chrono::seconds ttl);
+
+      private:
+        struct Entry {
+          std::vector<std::string> addresses;
+          std::string connected;
+          std::chrono::steady_clock::time_point expires;
+        };
+
+        std::mutex mutex_;
+        std::unordered_map<std::string, Entry> entries_;
+        std::chrono::seconds ttl_ = std::chrono::seconds(30);
+      };
+
+    } // namespace postgresql
+  }   // namespace core
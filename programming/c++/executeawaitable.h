@@ -0,0 +1,73 @@
+#pragma once
+#include "connection.h"
+#include "recordset.h"
+#include <coroutine>
+
+  namespace core {
+    namespace postgresql {
+
+      // co_await asyncExecute(connection, "statement", &queryData) resumes the coroutine on the event loop of the
+      // connection, with an error when the connection is lost or destroyed first. The state lives in the coroutine
+      // frame, the handler captures a single pointer and fits into the small buffer of std::function, so nothing
+      // is allocated per query
+      class ExecuteAwaitable {
+      public:
+        struct Result {
+          Error error = Error::Success;
+          Recordset recordset;
+        };
+
+      public:
+        ExecuteAwaitable(Connection *connection, const char *preparedName, const QueryData *queryData, RequestId requestId) :
+            connection_(connection), preparedName_(preparedName), queryData_(queryData), requestId_(requestId) {}
+        ExecuteAwaitable(const ExecuteAwaitable &) = delete;
+        ExecuteAwaitable &operator=(const ExecuteAwaitable &) = delete;
+
+        bool await_ready() const noexcept {
+          return false;
+        }
+
+        // the handler may be called before execute returns, the coroutine is not suspended then
+        bool await_suspend(std::coroutine_handle<> handle) {
+          handle_ = handle;
+          connection_->execute(
+              preparedName_,
+              queryData_,
+              [this](const Error &error, Recordset &&recordset, const AsyncObjectPtr<Connection> &) {
+                result_.error = error;
+                result_.recordset = std::move(recordset);
+                if(isSuspended_) {
+                  handle_.resume();
+                } else {
+                  isCompleted_ = true;
+                }
+              },
+              requestId_);
+          if(isCompleted_) {
+            return false;
+          }
+          isSuspended_ = true;
+          return true;
+        }
+
+        Result await_resume() {
+          return std::move(result_);
+        }
+
+      private:
+        Connection *connection_;
+        const char *preparedName_;
+        const QueryData *queryData_;
+        RequestId requestId_;
+        std::coroutine_handle<> handle_;
+        Result result_;
+        bool isSuspended_ = false;
+        bool isCompleted_ = false;
+      };
+
+      inline ExecuteAwaitable asyncExecute(const AsyncObjectPtr<Connection> &connection, const char *preparedName, const QueryData *queryData = nullptr, RequestId requestId = InvalidRequestId) {
+        return ExecuteAwaitable(connection.get(), preparedName, queryData, requestId);
+      }
+
+    } // namespace postgresql
+  }   // namespace core
@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+
+  namespace core {
+    namespace postgresql {
+
+      // intrusive lock-free queue of many producers and one consumer. Items derive from MpscQueue::Node and are
+      // owned by the caller. pop may return nullptr while a producer is in the middle of push, the producer
+      // is expected to wake the consumer after push returns
+      class MpscQueue {
+      public:
+        struct Node {
+          std::atomic<Node *> next = nullptr;
+        };
+
+      public:
+        MpscQueue() : head_(&stub_), tail_(&stub_) {}
+        MpscQueue(const MpscQueue &) = delete;
+        MpscQueue &operator=(const MpscQueue &) = delete;
+
+        void push(Node *node) {
+          node->next.store(nullptr, std::memory_order_relaxed);
+          Node *prev = head_.exchange(node, std::memory_order_acq_rel);
+          prev->next.store(node, std::memory_order_release);
+        }
+
+        Node *pop() {
+          Node *tail = tail_;
+          Node *next = tail->next.load(std::memory_order_acquire);
+          if(tail == &stub_) {
+            if(next == nullptr) {
+              return nullptr;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+          }
+          if(next) {
+            tail_ = next;
+            return tail;
+          }
+          if(tail != head_.load(std::memory_order_acquire)) {
+            return nullptr;
+          }
+          push(&stub_);
+          next = tail->next.load(std::memory_order_acquire);
+          if(next) {
+            tail_ = next;
+            return tail;
+          }
+          return nullptr;
+        }
+
+      private:
+        Node stub_;
+        std::atomic<Node *> head_;
+        Node *tail_;
+      };
+
+    } // namespace postgresql
+  }   // namespace core
@@ -0,0 +1,147 @@
+#pragma once
+#include "binaryformat.h"
+#include "core/common/error.h"
+#include "recordset.h"
+#include <algorithm>
+#include <libpq-fe.h>
+#include <span>
+#include <tuple>
+
+  namespace core {
+    namespace postgresql {
+
+      // typed access to a binary format Recordset. Column indices and types are resolved and checked once
+      // in initialize, values are decoded straight from the PGresult buffer. std::string_view columns point
+      // into the result and are valid while the Recordset is alive. NULL is decoded as std::nullopt for
+      // std::optional columns and as T{} otherwise.
+      template <typename... Columns>
+      class RecordsetView {
+      public:
+        static constexpr size_t ColumnCount = sizeof...(Columns);
+        using Row = std::tuple<Columns...>;
+        template <size_t I>
+        using ColumnType = std::tuple_element_t<I, Row>;
+
+      public:
+        // columns are taken by position
+        Error initialize(const Recordset &recordset) {
+          std::array<int, ColumnCount> indices;
+          for(size_t i = 0; i < ColumnCount; i++) {
+            indices[i] = static_cast<int>(i);
+          }
+          return bind(recordset.handle(), indices);
+        }
+
+        // columns are taken by name
+        Error initialize(const Recordset &recordset, const std::array<const char *, ColumnCount> &names) {
+          PGresult *result = recordset.handle();
+          if(result == nullptr) {
+            return MAKE_ERROR("Recordset is empty");
+          }
+          std::array<int, ColumnCount> indices;
+          for(size_t i = 0; i < ColumnCount; i++) {
+            indices[i] = PQfnumber(result, names[i]);
+            if(indices[i] < 0) {
+              return MAKE_ERROR("Column %s is not found", names[i]);
+            }
+          }
+          return bind(result, indices);
+        }
+
+        size_t rowCount() const {
+          return rowCount_;
+        }
+
+        template <size_t I>
+        ColumnType<I> get(size_t row) const {
+          return decode<ColumnType<I>>(static_cast<int>(row), columns_[I]);
+        }
+
+        Row row(size_t row) const {
+          return rowImpl(static_cast<int>(row), std::make_index_sequence<ColumnCount>());
+        }
+
+        template <size_t I>
+        bool isNull(size_t row) const {
+          return PQgetisnull(result_, static_cast<int>(row), columns_[I]) != 0;
+        }
+
+        // appends the whole column
+        template <size_t I>
+        void column(std::vector<ColumnType<I>> &out) const {
+          out.reserve(out.size() + rowCount_);
+          for(size_t row = 0; row < rowCount_; row++) {
+            out.push_back(get<I>(row));
+          }
+        }
+
+        // fills min(out.size(), rowCount()) values and returns their number
+        template <size_t I>
+        size_t column(std::span<ColumnType<I>> out) const {
+          size_t count = std::min(out.size(), rowCount_);
+          for(size_t row = 0; row < count; row++) {
+            out[row] = get<I>(row);
+          }
+          return count;
+        }
+
+        // appends the elements of an array column of every row into one vector
+        template <size_t I>
+        void flatten(std::vector<typename ColumnType<I>::value_type> &out) const {
+          using Item = typename ColumnType<I>::value_type;
+          for(size_t row = 0; row < rowCount_; row++) {
+            int r = static_cast<int>(row);
+            if(!PQgetisnull(result_, r, columns_[I])) {
+              BinaryFormat<std::vector<Item>>::decode(PQgetvalue(result_, r, columns_[I]), PQgetlength(result_, r, columns_[I]), out);
+            }
+          }
+        }
+
+      private:
+        Error bind(PGresult *result, const std::array<int, ColumnCount> &indices) {
+          if(result == nullptr) {
+            return MAKE_ERROR("Recordset is empty");
+          }
+          if(PQnfields(result) < static_cast<int>(ColumnCount)) {
+            return MAKE_ERROR("Recordset has %d columns, %d expected", PQnfields(result), ColumnCount);
+          }
+          static constexpr std::array<bool (*)(unsigned int), ColumnCount> isCompatible = {binary::isCompatible<Columns>...};
+          for(size_t i = 0; i < ColumnCount; i++) {
+            if(PQfformat(result, indices[i]) != 1) {
+              return MAKE_ERROR("Column %d is not in binary format", indices[i]);
+            }
+            if(!isCompatible[i](PQftype(result, indices[i]))) {
+              return MAKE_ERROR("Wrong type %d of column %d", PQftype(result, indices[i]), indices[i]);
+            }
+          }
+          result_ = result;
+          columns_ = indices;
+          rowCount_ = static_cast<size_t>(PQntuples(result));
+          return Error::Success;
+        }
+
+        template <typename T>
+        T decode(int row, int column) const {
+          if(PQgetisnull(result_, row, column)) {
+            return T{};
+          }
+          if constexpr(binary::IsOptional<T>::value) {
+            return BinaryFormat<typename T::value_type>::decode(PQgetvalue(result_, row, column), PQgetlength(result_, row, column));
+          } else {
+            return BinaryFormat<T>::decode(PQgetvalue(result_, row, column), PQgetlength(result_, row, column));
+          }
+        }
+
+        template <size_t... I>
+        Row rowImpl(int row, std::index_sequence<I...>) const {
+          return Row(decode<ColumnType<I>>(row, columns_[I])...);
+        }
+
+      private:
+        PGresult *result_ = nullptr;
+        std::array<int, ColumnCount> columns_ = {};
+        size_t rowCount_ = 0;
+      };
+
+    } // namespace postgresql
+  }   // namespace core
@@ -0,0 +1,158 @@
+#include "shardedconnectionpool.h"
+#include "core/microservice/eventloop.h"
+#include "recordset.h"
+
+  namespace core {
+    namespace postgresql {
+
+      ShardedConnectionPool::Mailbox::~Mailbox() {
+        destroy();
+      }
+
+      Error ShardedConnectionPool::Mailbox::initialize(EventLoop *eventLoop) {
+        async_ = new uv_async_t;
+        int rc = uv_async_init(eventLoop->handle(), async_, asyncCallback);
+        if(rc != 0) {
+          delete async_;
+          async_ = nullptr;
+          return MAKE_ERROR("Unable to initialize async handle. %s", uv_strerror(rc));
+        }
+        uv_handle_set_data(reinterpret_cast<uv_handle_t *>(async_), this);
+        return Error::Success;
+      }
+
+      void ShardedConnectionPool::Mailbox::destroy() {
+        if(async_) {
+          uv_close(reinterpret_cast<uv_handle_t *>(async_), [](uv_handle_t *handle) {
+            delete reinterpret_cast<uv_async_t *>(handle);
+          });
+          async_ = nullptr;
+        }
+        // tasks may post again while they are completed
+        while(MpscQueue::Node *node = queue_.pop()) {
+          Task *task = static_cast<Task *>(node);
+          task->run(MAKE_ERROR("Sharded connection pool is destroyed"));
+          delete task;
+        }
+      }
+
+      void ShardedConnectionPool::Mailbox::asyncCallback(uv_async_t *handle) {
+        Mailbox *_this = reinterpret_cast<Mailbox *>(uv_handle_get_data(reinterpret_cast<uv_handle_t *>(handle)));
+        while(MpscQueue::Node *node = _this->queue_.pop()) {
+          Task *task = static_cast<Task *>(node);
+          task->run(Error::Success);
+          delete task;
+        }
+      }
+
+      ShardedConnectionPool::~ShardedConnectionPool() {
+        destroy();
+      }
+
+      Error ShardedConnectionPool::initialize(const std::vector<EventLoop *> &shardLoops, const std::vector<EventLoop *> &callerLoops, const Options &options, const ConnectionPool::Settings &settings) {
+        destroy();
+        if(shardLoops.empty()) {
+          return MAKE_ERROR("Unable to initialize sharded connection pool. Event loop list is empty");
+        }
+        for(EventLoop *eventLoop : shardLoops) {
+          std::unique_ptr<Shard> shard = std::make_unique<Shard>();
+          shard->pool = AsyncObjectPtr<ConnectionPool>(CONSTRUCT_ASYNC_OBJECT("ShardedConnectionPool::pool"), eventLoop);
+          Error error = shard->pool->initialize(options, settings);
+          if(error.isSuccess()) {
+            error = shard->mailbox.initialize(eventLoop);
+          }
+          if(error.isFail()) {
+            shard->pool->destroy();
+            destroy();
+            return MAKE_CHILD_ERROR(error, "Unable to initialize sharded connection pool");
+          }
+          shards_.push_back(std::move(shard));
+        }
+        for(EventLoop *eventLoop : callerLoops) {
+          std::unique_ptr<Mailbox> &mailbox = callers_[eventLoop];
+          if(mailbox) {
+            continue;
+          }
+          mailbox = std::make_unique<Mailbox>();
+          Error error = mailbox->initialize(eventLoop);
+          if(error.isFail()) {
+            destroy();
+            return MAKE_CHILD_ERROR(error, "Unable to initialize sharded connection pool");
+          }
+        }
+        return Error::Success;
+      }
+
+      // requests not yet taken by a shard and the ones in its pool complete with an error, the results are handed
+      // to the caller mailboxes, which are destroyed last and call every handler left in them
+      void ShardedConnectionPool::destroy() {
+        for(std::unique_ptr<Shard> &shard : shards_) {
+          shard->mailbox.destroy();
+          shard->pool->destroy();
+        }
+        shards_.clear();
+        std::unordered_map<EventLoop *, std::unique_ptr<Mailbox>> callers = std::move(callers_);
+        callers_.clear();
+        callers.clear();
+      }
+
+      void ShardedConnectionPool::addPreparedStatement(const char *name, const char *query, const std::vector<unsigned int> *types) {
+        for(std::unique_ptr<Shard> &shard : shards_) {
+          shard->mailbox.post([pool = shard->pool.get(), name = std::string(name), query = std::string(query), hasTypes = types != nullptr, types = types ? *types : std::vector<unsigned int>()](const Error &error) {
+            if(error.isSuccess()) {
+              pool->addPreparedStatement(name.c_str(), query.c_str(), hasTypes ? &types : nullptr);
+            }
+          });
+        }
+      }
+
+      // the shard with the fewest requests in flight, shards are few so all of them are checked
+      ShardedConnectionPool::Shard *ShardedConnectionPool::select() {
+        Shard *best = shards_.front().get();
+        size_t bestCount = best->outstandingRequests.load(std::memory_order_relaxed);
+        for(size_t i = 1; i < shards_.size() && bestCount > 0; i++) {
+          size_t count = shards_[i]->outstandingRequests.load(std::memory_order_relaxed);
+          if(count < bestCount) {
+            best = shards_[i].get();
+            bestCount = count;
+          }
+        }
+        return best;
+      }
+
+      void ShardedConnectionPool::execute(EventLoop *callerLoop, const char *preparedName, const QueryData *queryData, ExecuteHandler &&handler, RequestId requestId, ConnectionPool::Intent intent) {
+        std::unordered_map<EventLoop *, std::unique_ptr<Mailbox>>::iterator caller = callers_.find(callerLoop);
+        if(caller == callers_.end()) {
+          handler(MAKE_ERROR("Event loop is not a caller of the sharded connection pool"), {}, {});
+          return;
+        }
+        if(shards_.empty()) {
+          handler(MAKE_ERROR("Sharded connection pool is not initialized"), {}, {});
+          return;
+        }
+        Shard *shard = select();
+        shard->outstandingRequests.fetch_add(1, std::memory_order_relaxed);
+        shard->mailbox.post([shard, callerMailbox = caller->second.get(), name = std::string(preparedName), queryData, handler = std::move(handler), requestId, intent](const Error &error) mutable {
+          if(error.isFail()) {
+            callerMailbox->post([handler = std::move(handler), error](const Error &) mutable {
+              handler(error, {}, {});
+            });
+            return;
+          }
+          shard->pool->execute(
+              name.c_str(),
+              queryData,
+              [shard, callerMailbox, handler = std::move(handler)](const Error &error, Recordset &&result, const AsyncObjectPtr<Connection> &) mutable {
+                shard->outstandingRequests.fetch_sub(1, std::memory_order_relaxed);
+                // the result is delivered even when the caller mailbox is destroyed first
+                callerMailbox->post([handler = std::move(handler), error, result = std::move(result)](const Error &) mutable {
+                  handler(error, std::move(result), {});
+                });
+              },
+              requestId,
+              intent);
+        });
+      }
+
+    } // namespace postgresql
+  }   // namespace core
@@ -0,0 +1,90 @@
+#pragma once
+#include "connectionpool.h"
+#include "mpscqueue.h"
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <uv.h>
+
+  namespace core {
+    namespace postgresql {
+
+      // connection pools spread over several event loops, each loop running on its own thread. execute may be
+      // called from any caller loop given to initialize, the request is handed to the least loaded shard and the
+      // handler is called back on the caller loop. initialize and destroy are called while the loops are not running
+      class ShardedConnectionPool {
+      public:
+        ShardedConnectionPool() = default;
+        ~ShardedConnectionPool();
+        ShardedConnectionPool(const ShardedConnectionPool &) = delete;
+        ShardedConnectionPool &operator=(const ShardedConnectionPool &) = delete;
+
+        Error initialize(const std::vector<EventLoop *> &shardLoops, const std::vector<EventLoop *> &callerLoops, const Options &options, const ConnectionPool::Settings &settings);
+        void destroy();
+
+        // thread safe
+        void addPreparedStatement(const char *name, const char *query, const std::vector<unsigned int> *types = nullptr);
+        // thread safe. queryData must stay valid until the handler is called, the handler gets no connection
+        void execute(EventLoop *callerLoop, const char *preparedName, const QueryData *queryData, ExecuteHandler &&handler, RequestId requestId, ConnectionPool::Intent intent = ConnectionPool::Intent::ReadWrite);
+
+        size_t shardCount() const;
+
+      private:
+        // tasks posted to a loop from other threads, one uv_async wakeup runs all of them. A task gets Error::Success,
+        // or the destroy error when the mailbox is destroyed before it ran, so its handler is still called
+        class Mailbox {
+        public:
+          ~Mailbox();
+          Error initialize(EventLoop *eventLoop);
+          void destroy();
+
+          template <typename F>
+          void post(F &&function);
+
+        private:
+          struct Task : MpscQueue::Node {
+            virtual ~Task() = default;
+            virtual void run(const Error &error) = 0;
+          };
+
+          static void asyncCallback(uv_async_t *handle);
+
+        private:
+          MpscQueue queue_;
+          uv_async_t *async_ = nullptr;
+        };
+
+        struct Shard {
+          AsyncObjectPtr<ConnectionPool> pool;
+          Mailbox mailbox;
+          std::atomic<size_t> outstandingRequests = 0;
+        };
+
+        Shard *select();
+
+      private:
+        std::vector<std::unique_ptr<Shard>> shards_;
+        std::unordered_map<EventLoop *, std::unique_ptr<Mailbox>> callers_;
+      };
+
+      template <typename F>
+      void ShardedConnectionPool::Mailbox::post(F &&function) {
+        struct FunctionTask : Task {
+          FunctionTask(F &&function) : function(std::forward<F>(function)) {}
+          void run(const Error &error) override {
+            function(error);
+          }
+          std::decay_t<F> function;
+        };
+        queue_.push(new FunctionTask(std::forward<F>(function)));
+        if(async_) {
+          uv_async_send(async_);
+        }
+      }
+
+      inline size_t ShardedConnectionPool::shardCount() const {
+        return shards_.size();
+      }
+
+    } // namespace postgresql
+  }   // namespace core
@@ -0,0 +1,106 @@
+#include "sslcredentials.h"
+#include <cerrno>
+#include <cstring>
+#include <openssl/evp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+  namespace core {
+    namespace postgresql {
+
+      std::mutex SslCredentials::mutex_;
+      std::unordered_map<std::string, std::weak_ptr<const SslCredentials>> SslCredentials::cache_;
+
+      SslCredentials::~SslCredentials() {
+        for(File *file : {&certificate_, &key_, &ca_}) {
+          if(file->fd >= 0) {
+            close(file->fd);
+          }
+        }
+      }
+
+      // the private key is not kept in the cache, it is identified by a digest of all three parts with their lengths
+      Error SslCredentials::digest(std::string_view certificate, std::string_view key, std::string_view ca, std::string &digest) {
+        EVP_MD_CTX *context = EVP_MD_CTX_new();
+        if(context == nullptr) {
+          return MAKE_ERROR("Unable to create digest context");
+        }
+        bool isSuccess = EVP_DigestInit_ex(context, EVP_sha256(), nullptr) == 1;
+        for(std::string_view part : {certificate, key, ca}) {
+          uint64_t size = part.size();
+          isSuccess = isSuccess && EVP_DigestUpdate(context, &size, sizeof(size)) == 1 && EVP_DigestUpdate(context, part.data(), part.size()) == 1;
+        }
+        unsigned char value[EVP_MAX_MD_SIZE];
+        unsigned int length = 0;
+        isSuccess = isSuccess && EVP_DigestFinal_ex(context, value, &length) == 1;
+        EVP_MD_CTX_free(context);
+        if(!isSuccess) {
+          return MAKE_ERROR("Unable to compute ssl credentials digest");
+        }
+        digest.assign(reinterpret_cast<const char *>(value), length);
+        return Error::Success;
+      }
+
+      Error SslCredentials::get(std::string_view certificate, std::string_view key, std::string_view ca, std::shared_ptr<const SslCredentials> &credentials) {
+        std::string cacheKey;
+        Error error = digest(certificate, key, ca, cacheKey);
+        if(error.isFail()) {
+          return error;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unordered_map<std::string, std::weak_ptr<const SslCredentials>>::iterator i = cache_.find(cacheKey);
+        if(i != cache_.end()) {
+          credentials = i->second.lock();
+          if(credentials) {
+            return Error::Success;
+          }
+        }
+
+        std::shared_ptr<SslCredentials> created(new SslCredentials());
+        error = create(certificate, created->certificate_);
+        if(error.isSuccess()) {
+          error = create(key, created->key_);
+        }
+        if(error.isSuccess() && !ca.empty()) {
+          error = create(ca, created->ca_);
+        }
+        if(error.isFail()) {
+          return error;
+        }
+        // expired entries are dropped when another set of credentials is added
+        for(i = cache_.begin(); i != cache_.end();) {
+          i = i->second.expired() ? cache_.erase(i) : std::next(i);
+        }
+        cache_.insert_or_assign(std::move(cacheKey), created);
+        credentials = std::move(created);
+        return Error::Success;
+      }
+
+      Error SslCredentials::create(std::string_view data, File &file) {
+        file.fd = memfd_create("postgresql-ssl", MFD_CLOEXEC);
+        if(file.fd < 0) {
+          return MAKE_ERROR("Unable to create ssl memory file. %s", strerror(errno));
+        }
+        // memory files are created world readable, libpq refuses such a key and nobody else should read it
+        if(fchmod(file.fd, 0600) != 0) {
+          return MAKE_ERROR("Unable to set ssl memory file mode. %s", strerror(errno));
+        }
+        size_t written = 0;
+        while(written < data.size()) {
+          ssize_t rc = write(file.fd, data.data() + written, data.size() - written);
+          if(rc < 0) {
+            if(errno == EINTR) {
+              continue;
+            }
+            return MAKE_ERROR("Unable to write ssl memory file. %s", strerror(errno));
+          }
+          written += static_cast<size_t>(rc);
+        }
+        file.path = "/proc/self/fd/" + std::to_string(file.fd);
+        return Error::Success;
+      }
+
+    } // namespace postgresql
+  }   // namespace core
@@ -0,0 +1,55 @@
+#pragma once
+#include "core/common/error.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+  namespace core {
+    namespace postgresql {
+
+      // certificate, key and ca written once per distinct ssl options into memory files shared by all connections.
+      // libpq takes file names, the files are passed as /proc/self/fd paths and closed with the last user
+      class SslCredentials {
+      public:
+        ~SslCredentials();
+
+        static Error get(std::string_view certificate, std::string_view key, std::string_view ca, std::shared_ptr<const SslCredentials> &credentials);
+
+        const std::string &certificatePath() const;
+        const std::string &keyPath() const;
+        // empty without trusted certificates
+        const std::string &caPath() const;
+
+      private:
+        struct File {
+          int fd = -1;
+          std::string path;
+        };
+
+        SslCredentials() = default;
+        static Error digest(std::string_view certificate, std::string_view key, std::string_view ca, std::string &digest);
+        static Error create(std::string_view data, File &file);
+
+      private:
+        File certificate_;
+        File key_;
+        File ca_;
+
+        static std::mutex mutex_;
+        static std::unordered_map<std::string, std::weak_ptr<const SslCredentials>> cache_;
+      };
+
+      inline const std::string &SslCredentials::certificatePath() const {
+        return certificate_.path;
+      }
+      inline const std::string &SslCredentials::keyPath() const {
+        return key_.path;
+      }
+      inline const std::string &SslCredentials::caPath() const {
+        return ca_.path;
+      }
+
+    } // namespace postgresql
+  }   // namespace core
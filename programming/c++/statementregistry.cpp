@@ -0,0 +1,60 @@
+#include "statementregistry.h"
+
+  namespace core {
+    namespace postgresql {
+
+      StatementRegistry *StatementRegistry::instance() {
+        static StatementRegistry registry;
+        return &registry;
+      }
+
+      StatementRegistry::~StatementRegistry() {
+        for(std::atomic<Statement *> &chunk : chunks_) {
+          delete[] chunk.load(std::memory_order_relaxed);
+        }
+      }
+
+      StatementId StatementRegistry::declare(std::string_view name, std::string_view query, const std::vector<unsigned int> *types) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unordered_map<std::string, StatementId>::const_iterator i = index_.find(std::string(name));
+        if(i != index_.end()) {
+          const Statement &existing = statement(i->second);
+          if(existing.query != query || existing.hasTypes != (types != nullptr) || (types && existing.types != *types)) {
+            return InvalidStatementId;
+          }
+          return i->second;
+        }
+        size_t index = size_.load(std::memory_order_relaxed);
+        if(index >= MaxChunks * ChunkSize) {
+          return InvalidStatementId;
+        }
+        std::atomic<Statement *> &chunk = chunks_[index / ChunkSize];
+        if(chunk.load(std::memory_order_relaxed) == nullptr) {
+          chunk.store(new Statement[ChunkSize], std::memory_order_relaxed);
+        }
+        StatementId id = static_cast<StatementId>(index);
+        Statement &statement = chunk.load(std::memory_order_relaxed)[index % ChunkSize];
+        statement.name = name;
+        statement.query = query;
+        statement.hasTypes = types != nullptr;
+        if(types) {
+          statement.types = *types;
+        }
+        index_.emplace(statement.name, id);
+        size_.store(index + 1, std::memory_order_release);
+        return id;
+      }
+
+      void StatementRegistry::setParameterTypes(StatementId id, std::vector<unsigned int> &&parameterTypes) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t index = static_cast<size_t>(id);
+        Statement &statement = chunks_[index / ChunkSize].load(std::memory_order_relaxed)[index % ChunkSize];
+        if(statement.isDescribed.load(std::memory_order_relaxed)) {
+          return;
+        }
+        statement.parameterTypes = std::move(parameterTypes);
+        statement.isDescribed.store(true, std::memory_order_release);
+      }
+
+    } // namespace postgresql
+  }   // namespace core
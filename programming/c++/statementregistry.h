@@ -0,0 +1,90 @@
+#pragma once
+#include "binaryformat.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+  namespace core {
+    namespace postgresql {
+
+      enum class StatementId : uint32_t {};
+      constexpr StatementId InvalidStatementId = static_cast<StatementId>(UINT32_MAX);
+
+      // statement with compile time parameter types, see Connection::execute
+      template <typename... Args>
+      class TypedStatementId {
+      public:
+        explicit TypedStatementId(StatementId id) : id_(id) {}
+        StatementId id() const {
+          return id_;
+        }
+
+      private:
+        StatementId id_;
+      };
+
+      // process wide list of prepared statements. A statement is declared once, usually at startup, and every connection
+      // prepares it on its first use. Parameter types reported by the server are kept here for all connections.
+      // Statements are stored in chunks that never move, so they are read without the lock from every thread
+      class StatementRegistry {
+      public:
+        struct Statement {
+          std::string name;
+          std::string query;
+          std::vector<unsigned int> types;
+          bool hasTypes = false;
+          std::vector<unsigned int> parameterTypes;
+          std::atomic<bool> isDescribed = false;
+        };
+
+      public:
+        static StatementRegistry *instance();
+        ~StatementRegistry();
+
+        // declaring the same name again returns the existing statement, with another query or other parameter types
+        // it is InvalidStatementId. So is a declare beyond MaxChunks * ChunkSize statements
+        StatementId declare(std::string_view name, std::string_view query, const std::vector<unsigned int> *types = nullptr);
+        // parameter types come from Args and need no describe nor per call checks
+        template <typename... Args>
+        TypedStatementId<Args...> declare(std::string_view name, std::string_view query);
+
+        const Statement &statement(StatementId id) const;
+        size_t size() const;
+
+        void setParameterTypes(StatementId id, std::vector<unsigned int> &&parameterTypes);
+
+      private:
+        static constexpr size_t ChunkSize = 256;
+        static constexpr size_t MaxChunks = 256;
+
+        std::mutex mutex_;
+        std::atomic<Statement *> chunks_[MaxChunks] = {};
+        std::unordered_map<std::string, StatementId> index_;
+        std::atomic<size_t> size_ = 0;
+      };
+
+      template <typename... Args>
+      TypedStatementId<Args...> StatementRegistry::declare(std::string_view name, std::string_view query) {
+        std::vector<unsigned int> types(QueryParameters<Args...>::types.begin(), QueryParameters<Args...>::types.end());
+        StatementId id = declare(name, query, &types);
+        if(id != InvalidStatementId) {
+          setParameterTypes(id, std::move(types));
+        }
+        return TypedStatementId<Args...>(id);
+      }
+
+      // id must be below size(), its chunk is published before size_
+      inline const StatementRegistry::Statement &StatementRegistry::statement(StatementId id) const {
+        size_t index = static_cast<size_t>(id);
+        return chunks_[index / ChunkSize].load(std::memory_order_relaxed)[index % ChunkSize];
+      }
+      inline size_t StatementRegistry::size() const {
+        return size_.load(std::memory_order_acquire);
+      }
+
+    } // namespace postgresql
+  }   // namespace core
@@ -0,0 +1,133 @@
+#include "statistics.h"
+#include <algorithm>
+
+  namespace core {
+    namespace postgresql {
+
+      uint64_t Statistics::Histogram::bucketValue(size_t bucket) {
+        if(bucket < SubBucketCount) {
+          return bucket;
+        }
+        size_t exponent = bucket / SubBucketCount + SubBucketBits - 1;
+        uint64_t subBucket = bucket % SubBucketCount;
+        return (uint64_t(1) << exponent) | (subBucket << (exponent - SubBucketBits));
+      }
+
+      uint64_t Statistics::HistogramSnapshot::percentile(double percentile) const {
+        if(count == 0) {
+          return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(percentile / 100 * static_cast<double>(count));
+        rank = std::clamp<uint64_t>(rank, 1, count);
+        uint64_t seen = 0;
+        for(size_t i = 0; i < buckets.size(); i++) {
+          seen += buckets[i];
+          if(seen >= rank) {
+            return std::min(Histogram::bucketValue(i), max);
+          }
+        }
+        return max;
+      }
+
+      uint64_t Statistics::HistogramSnapshot::mean() const {
+        return count == 0 ? 0 : sum / count;
+      }
+
+      size_t Statistics::KeyHash::operator()(const KeyView &key) const {
+        size_t hash = std::hash<std::string_view>()(key.statement);
+        hash ^= std::hash<size_t>()(key.hostIndex) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+        hash ^= std::hash<ConnectionId>()(key.connectionId) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+        return hash;
+      }
+
+      size_t Statistics::KeyHash::operator()(const Key &key) const {
+        return (*this)(KeyView{key.hostIndex, key.connectionId, key.statement});
+      }
+
+      bool Statistics::KeyEqual::operator()(const KeyView &left, const Key &right) const {
+        return left.hostIndex == right.hostIndex && left.connectionId == right.connectionId && left.statement == right.statement;
+      }
+
+      bool Statistics::KeyEqual::operator()(const Key &left, const KeyView &right) const {
+        return (*this)(right, left);
+      }
+
+      bool Statistics::KeyEqual::operator()(const Key &left, const Key &right) const {
+        return left == right;
+      }
+
+      Statistics *Statistics::instance() {
+        static Statistics statistics;
+        return &statistics;
+      }
+
+      Statistics::Shard *Statistics::shard() {
+        thread_local Shard *shard = nullptr;
+        if(shard == nullptr) {
+          std::lock_guard<std::mutex> lock(mutex_);
+          shard = shards_.emplace_back(std::make_unique<Shard>()).get();
+        }
+        return shard;
+      }
+
+      Statistics::Series *Statistics::connectionSeries(size_t hostIndex, ConnectionId connectionId) {
+        return series({hostIndex, connectionId, std::string_view()});
+      }
+
+      Statistics::Series *Statistics::statementSeries(size_t hostIndex, std::string_view statement) {
+        return series({hostIndex, {}, statement});
+      }
+
+      Statistics::Series *Statistics::series(const KeyView &key) {
+        Shard *shard = this->shard();
+        // the index is only changed by the owner thread, so it is searched without the lock
+        std::unordered_map<Key, Series *, KeyHash, KeyEqual>::const_iterator i = shard->index.find(key);
+        if(i != shard->index.end()) {
+          return i->second;
+        }
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        Series *series = &shard->series.emplace_back();
+        shard->index.emplace(Key{key.hostIndex, key.connectionId, std::string(key.statement)}, series);
+        return series;
+      }
+
+      Statistics::Snapshot Statistics::snapshot() const {
+        Snapshot snapshot;
+        std::unordered_map<Key, size_t, KeyHash, KeyEqual> index;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(const std::unique_ptr<Shard> &shard : shards_) {
+          std::lock_guard<std::mutex> shardLock(shard->mutex);
+          for(const std::pair<const Key, Series *> &item : shard->index) {
+            std::pair<std::unordered_map<Key, size_t, KeyHash, KeyEqual>::iterator, bool> inserted = index.emplace(item.first, snapshot.size());
+            if(inserted.second) {
+              snapshot.emplace_back().key = item.first;
+            }
+            SeriesSnapshot &result = snapshot[inserted.first->second];
+            const Series &series = *item.second;
+            for(size_t c = 0; c < series.counters_.size(); c++) {
+              result.counters[c] += series.counters_[c].load(std::memory_order_relaxed);
+            }
+            for(size_t h = 0; h < series.histograms_.size(); h++) {
+              const Histogram &histogram = series.histograms_[h];
+              HistogramSnapshot &target = result.histograms[h];
+              uint64_t count = histogram.count_.load(std::memory_order_relaxed);
+              if(count == 0) {
+                continue;
+              }
+              if(target.buckets.empty()) {
+                target.buckets.resize(Histogram::BucketCount);
+              }
+              target.count += count;
+              target.sum += histogram.sum_.load(std::memory_order_relaxed);
+              target.max = std::max(target.max, histogram.max_.load(std::memory_order_relaxed));
+              for(size_t b = 0; b < Histogram::BucketCount; b++) {
+                target.buckets[b] += histogram.buckets_[b].load(std::memory_order_relaxed);
+              }
+            }
+          }
+        }
+        return snapshot;
+      }
+
+    } // namespace postgresql
+  }   // namespace core
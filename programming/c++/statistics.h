@@ -0,0 +1,189 @@
+#pragma once
+#include "types.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+  namespace core {
+    namespace postgresql {
+
+      // latency histograms and counters of connections and statements. Every thread records into its own shard
+      // without locks, a snapshot aggregates all shards. The shard mutex is only taken when a series is added
+      // and when a snapshot is taken
+      class Statistics {
+      public:
+        enum class Stage {
+          Dns,       // host name resolution
+          Connect,   // PQconnectStart until the connection is ready, including ssl and authentication
+          Reconnect, // connection lost until it is ready again
+          Queue,     // waiting in the connection pool for a free connection
+          Send,      // request queued in libpq until it is written to the socket
+          FirstByte, // request sent until its first result is received
+          Complete,  // request sent until its handler is called
+          Count
+        };
+
+        enum class Counter {
+          Connects,
+          Disconnects,
+          Requests,
+          Errors,
+          Abandoned, // timed out or cancelled
+          Count
+        };
+
+        // log-linear buckets of microseconds, values within a bucket differ by less than 1/SubBucketCount
+        class Histogram {
+        public:
+          static constexpr size_t SubBucketBits = 3;
+          static constexpr size_t SubBucketCount = 1 << SubBucketBits;
+          static constexpr size_t BucketCount = SubBucketCount * (64 - SubBucketBits + 1);
+
+          static size_t bucket(uint64_t value);
+          static uint64_t bucketValue(size_t bucket);
+
+          void record(uint64_t value);
+
+        private:
+          friend class Statistics;
+          std::array<std::atomic<uint64_t>, BucketCount> buckets_ = {};
+          std::atomic<uint64_t> count_ = 0;
+          std::atomic<uint64_t> sum_ = 0;
+          std::atomic<uint64_t> max_ = 0;
+        };
+
+        struct Key {
+          size_t hostIndex = 0;
+          // connection series have no statement, statement series have no connection
+          ConnectionId connectionId = {};
+          std::string statement;
+
+          bool operator==(const Key &other) const = default;
+        };
+
+        class Series {
+        public:
+          void record(Stage stage, std::chrono::steady_clock::duration duration);
+          void increment(Counter counter);
+
+        private:
+          friend class Statistics;
+          std::array<Histogram, static_cast<size_t>(Stage::Count)> histograms_;
+          std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::Count)> counters_ = {};
+        };
+
+        struct HistogramSnapshot {
+          uint64_t count = 0;
+          uint64_t sum = 0;
+          uint64_t max = 0;
+          std::vector<uint64_t> buckets;
+
+          // microseconds, percentile from 0 to 100
+          uint64_t percentile(double percentile) const;
+          uint64_t mean() const;
+        };
+
+        struct SeriesSnapshot {
+          Key key;
+          std::array<HistogramSnapshot, static_cast<size_t>(Stage::Count)> histograms;
+          std::array<uint64_t, static_cast<size_t>(Counter::Count)> counters = {};
+        };
+
+        using Snapshot = std::vector<SeriesSnapshot>;
+
+      public:
+        static Statistics *instance();
+
+        // series of the calling thread, the pointer stays valid for the lifetime of the process. Series are never
+        // freed, so connection ids are reused by the connections replacing closed ones
+        Series *connectionSeries(size_t hostIndex, ConnectionId connectionId);
+        Series *statementSeries(size_t hostIndex, std::string_view statement);
+
+        Snapshot snapshot() const;
+
+        void setEnabled(bool isEnabled);
+        bool isEnabled() const;
+
+      private:
+        // lookups do not allocate, the key is only copied when a series is added
+        struct KeyView {
+          size_t hostIndex;
+          ConnectionId connectionId;
+          std::string_view statement;
+        };
+
+        struct KeyHash {
+          using is_transparent = void;
+          size_t operator()(const KeyView &key) const;
+          size_t operator()(const Key &key) const;
+        };
+
+        struct KeyEqual {
+          using is_transparent = void;
+          bool operator()(const KeyView &left, const Key &right) const;
+          bool operator()(const Key &left, const KeyView &right) const;
+          bool operator()(const Key &left, const Key &right) const;
+        };
+
+        struct Shard {
+          std::mutex mutex;
+          std::deque<Series> series;
+          std::unordered_map<Key, Series *, KeyHash, KeyEqual> index;
+        };
+
+        Shard *shard();
+        Series *series(const KeyView &key);
+
+      private:
+        mutable std::mutex mutex_;
+        std::vector<std::unique_ptr<Shard>> shards_;
+        std::atomic<bool> isEnabled_ = true;
+      };
+
+      inline size_t Statistics::Histogram::bucket(uint64_t value) {
+        if(value < SubBucketCount) {
+          return static_cast<size_t>(value);
+        }
+        size_t exponent = 63 - static_cast<size_t>(__builtin_clzll(value));
+        size_t subBucket = static_cast<size_t>(value >> (exponent - SubBucketBits)) & (SubBucketCount - 1);
+        return SubBucketCount * (exponent - SubBucketBits + 1) + subBucket;
+      }
+
+      // only the owner thread writes, so plain load and store are enough
+      inline void Statistics::Histogram::record(uint64_t value) {
+        std::atomic<uint64_t> &bucket = buckets_[Histogram::bucket(value)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        if(value > max_.load(std::memory_order_relaxed)) {
+          max_.store(value, std::memory_order_relaxed);
+        }
+      }
+
+      inline void Statistics::Series::record(Stage stage, std::chrono::steady_clock::duration duration) {
+        int64_t microseconds = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+        histograms_[static_cast<size_t>(stage)].record(microseconds > 0 ? static_cast<uint64_t>(microseconds) : 0);
+      }
+
+      inline void Statistics::Series::increment(Counter counter) {
+        std::atomic<uint64_t> &value = counters_[static_cast<size_t>(counter)];
+        value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      }
+
+      inline void Statistics::setEnabled(bool isEnabled) {
+        isEnabled_.store(isEnabled, std::memory_order_relaxed);
+      }
+      inline bool Statistics::isEnabled() const {
+        return isEnabled_.load(std::memory_order_relaxed);
+      }
+
+    } // namespace postgresql
+  }   // namespace core
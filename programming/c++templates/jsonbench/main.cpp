@@ -0,0 +1,274 @@
+#include "jsontape.h"
+#include "jsontapedeserializer.h"
+#include "serializable.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory_resource>
+#include <random>
+#include <string>
+
+// throughput of JsonTape for every backend the cpu supports on a payload shaped like the arguments of
+// create_initial_group_v1: hundreds of member ids with encrypted keys and service data entries. Then
+// Deserializer against JsonTapeDeserializer on the same payload, walking its events and decoding it whole
+// through Serializable::deserialize. Then the time to serialize and deserialize one member of it, declared
+// with a member table and with a member list
+//
+//   jsonbench [members] [iterations]
+
+using namespace core::serializers;
+
+namespace {
+  std::string makePayload(size_t memberCount) {
+    std::mt19937_64 random(42);
+    auto hex = [&random](size_t length) {
+      static const char digits[] = "0123456789abcdef";
+      std::string value;
+      for(size_t i = 0; i < length; i++) {
+        value.push_back(digits[random() % 16]);
+      }
+      return value;
+    };
+    std::string payload = "{\"group_id\":\"" + hex(32) + "\",\"name\":\"Team \\\"core\\\" \\u00e9\",\"version\":1,\"members\":[";
+    for(size_t i = 0; i < memberCount; i++) {
+      payload += i ? "," : "";
+      payload += "{\"member_id\":\"" + hex(32) + "\",\"role\":" + std::to_string(random() % 3) + ",\"is_admin\":" + (random() % 2 ? "true" : "false") +
+                 ",\"encrypted_key\":\"" + hex(128) + "\",\"service_data\":{\"device\":\"phone\\\\" + std::to_string(i) + "\",\"push\":null,\"scores\":[1.5,-2,3e10]}}";
+    }
+    payload += "]}";
+    return payload;
+  }
+
+  class TableMember : public Serializable {
+  public:
+    std::string memberId;
+    int64_t role = 0;
+    bool isAdmin = false;
+    std::string encryptedKey;
+
+    DECLARE_SERIALIZED_MEMBER_TABLE(SerializedMember<"member_id", &TableMember::memberId>,
+                                    SerializedMember<"role", &TableMember::role>,
+                                    SerializedMember<"is_admin", &TableMember::isAdmin>,
+                                    SerializedMember<"encrypted_key", &TableMember::encryptedKey>)
+  };
+
+  class ListMember : public Serializable {
+  public:
+    std::string memberId;
+    int64_t role = 0;
+    bool isAdmin = false;
+    std::string encryptedKey;
+
+    DECLARE_SERIALIZED_MEMBERS({{"member_id", &ListMember::memberId}, {"role", &ListMember::role}, {"is_admin", &ListMember::isAdmin}, {"encrypted_key", &ListMember::encryptedKey}})
+  };
+
+  class PayloadServiceData : public Serializable {
+  public:
+    using allocator_type = std::pmr::polymorphic_allocator<PayloadServiceData>;
+
+  public:
+    PayloadServiceData(const allocator_type &allocator = {}) : device(allocator), push(allocator), scores(allocator) {}
+    PayloadServiceData(const PayloadServiceData &other, const allocator_type &allocator) :
+        Serializable(other), device(other.device, allocator), push(other.push, allocator), scores(other.scores, allocator) {}
+
+    std::pmr::string device;
+    std::pmr::string push;
+    std::pmr::vector<double> scores;
+
+    DECLARE_SERIALIZED_MEMBER_TABLE(SerializedMember<"device", &PayloadServiceData::device>,
+                                    SerializedMember<"push", &PayloadServiceData::push>,
+                                    SerializedMember<"scores", &PayloadServiceData::scores>)
+  };
+
+  class PayloadMember : public Serializable {
+  public:
+    using allocator_type = std::pmr::polymorphic_allocator<PayloadMember>;
+
+  public:
+    explicit PayloadMember(const allocator_type &allocator = {}) : memberId(allocator), encryptedKey(allocator), serviceData(allocator) {}
+    PayloadMember(const PayloadMember &other, const allocator_type &allocator) :
+        Serializable(other), memberId(other.memberId, allocator), role(other.role), isAdmin(other.isAdmin), encryptedKey(other.encryptedKey, allocator),
+        serviceData(other.serviceData, allocator) {}
+
+    std::pmr::string memberId;
+    int64_t role = 0;
+    bool isAdmin = false;
+    std::pmr::string encryptedKey;
+    PayloadServiceData serviceData;
+
+    DECLARE_SERIALIZED_MEMBER_TABLE(SerializedMember<"member_id", &PayloadMember::memberId>,
+                                    SerializedMember<"role", &PayloadMember::role>,
+                                    SerializedMember<"is_admin", &PayloadMember::isAdmin>,
+                                    SerializedMember<"encrypted_key", &PayloadMember::encryptedKey>,
+                                    SerializedMember<"service_data", &PayloadMember::serviceData>)
+  };
+
+  class PayloadGroup : public Serializable {
+  public:
+    explicit PayloadGroup(std::pmr::memory_resource *resource) : groupId(resource), name(resource), members(resource) {}
+
+    std::pmr::string groupId;
+    std::pmr::string name;
+    int64_t version = 0;
+    std::pmr::vector<PayloadMember> members;
+
+    DECLARE_SERIALIZED_MEMBER_TABLE(SerializedMember<"group_id", &PayloadGroup::groupId>,
+                                    SerializedMember<"name", &PayloadGroup::name>,
+                                    SerializedMember<"version", &PayloadGroup::version>,
+                                    SerializedMember<"members", &PayloadGroup::members>)
+  };
+
+  // every event of the payload, then the payload decoded whole into an arena, iterations times each
+  template <typename D>
+  bool benchmarkDeserializer(const char *name, const std::string &payload, size_t memberCount, size_t iterations) {
+    size_t events = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < iterations; i++) {
+      D deserializer(payload);
+      size_t depth = 0;
+      events = 0;
+      do {
+        Deserializer::OperationResult result = deserializer.deserializeNext();
+        if(result.status() == Deserializer::OperationResult::Status::Fail) {
+          std::fprintf(stderr, "%s events failed: %s\n", name, deserializer.getLastError().message());
+          return false;
+        }
+        if(result.status() == Deserializer::OperationResult::Status::StartGroup) {
+          depth++;
+        } else if(result.status() == Deserializer::OperationResult::Status::EndGroup) {
+          depth--;
+        }
+        events++;
+      } while(depth > 0);
+    }
+    std::chrono::duration<double> eventsTime = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < iterations; i++) {
+      std::pmr::monotonic_buffer_resource arena;
+      PayloadGroup group(&arena);
+      D deserializer(payload);
+      Error error = group.deserialize(&deserializer);
+      if(error.isFail()) {
+        std::fprintf(stderr, "%s decode failed: %s\n", name, error.message());
+        return false;
+      }
+      if(group.members.size() != memberCount || group.name != "Team \"core\" \xc3\xa9") {
+        std::fprintf(stderr, "%s decode lost a member\n", name);
+        return false;
+      }
+    }
+    std::chrono::duration<double> decodeTime = std::chrono::steady_clock::now() - start;
+    double megabytes = static_cast<double>(payload.size() * iterations) / (1024.0 * 1024.0);
+    std::printf("%-8s events %8.1f MB/s   decode %8.1f MB/s   %zu events\n", name, megabytes / eventsTime.count(), megabytes / decodeTime.count(), events);
+    return true;
+  }
+
+  template <typename T>
+  bool benchmarkMember(const char *name, size_t iterations) {
+    T in;
+    in.memberId = std::string(32, 'a');
+    in.role = 2;
+    in.isAdmin = true;
+    in.encryptedKey = std::string(128, 'b');
+    std::string data;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < iterations; i++) {
+      Serializer serializer;
+      if(in.serialize(&serializer, {}).isFail()) {
+        std::fprintf(stderr, "%s serialize failed\n", name);
+        return false;
+      }
+      if(i == 0) {
+        data = serializer.data();
+      }
+    }
+    std::chrono::duration<double, std::nano> serializeTime = std::chrono::steady_clock::now() - start;
+    T out;
+    start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < iterations; i++) {
+      Deserializer deserializer(data);
+      if(out.deserialize(&deserializer).isFail()) {
+        std::fprintf(stderr, "%s deserialize failed\n", name);
+        return false;
+      }
+    }
+    std::chrono::duration<double, std::nano> deserializeTime = std::chrono::steady_clock::now() - start;
+    if(out.memberId != in.memberId || out.role != in.role || out.isAdmin != in.isAdmin || out.encryptedKey != in.encryptedKey) {
+      std::fprintf(stderr, "%s round trip lost a member\n", name);
+      return false;
+    }
+    double count = static_cast<double>(iterations);
+    std::printf("%-8s serialize %8.1f ns   deserialize %8.1f ns\n", name, serializeTime.count() / count, deserializeTime.count() / count);
+    return true;
+  }
+
+  const char *backendName(JsonTape::Backend backend) {
+    switch(backend) {
+      case JsonTape::Backend::Scalar:
+        return "scalar";
+      case JsonTape::Backend::Sse42:
+        return "sse4.2";
+      case JsonTape::Backend::Avx2:
+        return "avx2";
+      default:
+        return "auto";
+    }
+  }
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t memberCount = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 500;
+  size_t iterations = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2000;
+  std::string payload = makePayload(memberCount);
+  std::printf("payload %zu bytes, %zu iterations\n", payload.size(), iterations);
+
+  std::vector<uint32_t> expected;
+  Error error = JsonTape::index(payload, expected, JsonTape::Backend::Scalar);
+  if(error.isFail()) {
+    std::fprintf(stderr, "%s\n", error.message());
+    return 1;
+  }
+  std::vector<JsonTape::Backend> backends = {JsonTape::Backend::Scalar};
+  if(JsonTape::bestBackend() >= JsonTape::Backend::Sse42) {
+    backends.push_back(JsonTape::Backend::Sse42);
+  }
+  if(JsonTape::bestBackend() >= JsonTape::Backend::Avx2) {
+    backends.push_back(JsonTape::Backend::Avx2);
+  }
+  for(JsonTape::Backend backend : backends) {
+    std::vector<uint32_t> indexes;
+    JsonTape::index(payload, indexes, backend);
+    if(indexes != expected) {
+      std::fprintf(stderr, "%s index differs from scalar\n", backendName(backend));
+      return 1;
+    }
+    JsonTape tape;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < iterations; i++) {
+      JsonTape::index(payload, indexes, backend);
+    }
+    std::chrono::duration<double> indexTime = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < iterations; i++) {
+      error = tape.parse(payload, backend);
+    }
+    std::chrono::duration<double> parseTime = std::chrono::steady_clock::now() - start;
+    if(error.isFail()) {
+      std::fprintf(stderr, "%s\n", error.message());
+      return 1;
+    }
+    double megabytes = static_cast<double>(payload.size() * iterations) / (1024.0 * 1024.0);
+    std::printf("%-8s index %8.1f MB/s   parse %8.1f MB/s   %zu tape entries\n", backendName(backend), megabytes / indexTime.count(), megabytes / parseTime.count(), tape.entries().size());
+  }
+
+  if(!benchmarkDeserializer<Deserializer>("current", payload, memberCount, iterations) || !benchmarkDeserializer<JsonTapeDeserializer>("tape", payload, memberCount, iterations)) {
+    return 1;
+  }
+
+  // one member per member of the payload in every iteration
+  if(!benchmarkMember<ListMember>("list", memberCount * iterations) || !benchmarkMember<TableMember>("table", memberCount * iterations)) {
+    return 1;
+  }
+  return 0;
+}
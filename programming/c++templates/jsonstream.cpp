@@ -0,0 +1,251 @@
+#include "jsonstream.h"
+
+#include <cstdint>
+
+#include "jsontape.h"
+
+  namespace core {
+    namespace serializers {
+
+      Error JsonStream::initialize(MemberHandler &&memberHandler, ElementHandler &&elementHandler, std::unordered_set<std::string> &&streamedArrays) {
+        if(!memberHandler) {
+          return MAKE_ERROR("Json stream member handler is not set");
+        }
+        if(!elementHandler && !streamedArrays.empty()) {
+          return MAKE_ERROR("Json stream element handler is not set");
+        }
+        memberHandler_ = std::move(memberHandler);
+        elementHandler_ = std::move(elementHandler);
+        streamedArrays_ = std::move(streamedArrays);
+        reset();
+        return Error::Success;
+      }
+
+      void JsonStream::reset() {
+        state_ = State::BeforeObject;
+        key_.clear();
+        isKeyEscaped_ = false;
+        elementIndex_ = 0;
+        value_.clear();
+        isCapturing_ = false;
+        depth_ = 0;
+        isInString_ = false;
+        isEscaped_ = false;
+      }
+
+      Error JsonStream::fail(Error &&error) {
+        state_ = State::Failed;
+        return std::move(error);
+      }
+
+      Error JsonStream::finish() {
+        if(state_ == State::Failed) {
+          return MAKE_ERROR("Json stream has failed");
+        }
+        if(state_ != State::Done) {
+          return MAKE_ERROR("Unexpected end of json stream");
+        }
+        return Error::Success;
+      }
+
+      size_t JsonStream::scanValue(std::string_view chunk, size_t position) {
+        for(size_t i = position; i < chunk.size(); i++) {
+          char c = chunk[i];
+          if(isInString_) {
+            if(isEscaped_) {
+              isEscaped_ = false;
+            } else if(c == '\\') {
+              isEscaped_ = true;
+            } else if(c == '"') {
+              isInString_ = false;
+              if(depth_ == 0) {
+                return i + 1;
+              }
+            }
+            continue;
+          }
+          switch(c) {
+            case '"':
+              isInString_ = true;
+              break;
+            case '{':
+            case '[':
+              depth_++;
+              break;
+            case '}':
+            case ']':
+              // closes the container around a scalar
+              if(depth_ == 0) {
+                return i;
+              }
+              if(--depth_ == 0) {
+                return i + 1;
+              }
+              break;
+            case ',':
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\r':
+              if(depth_ == 0) {
+                return i;
+              }
+              break;
+            default:
+              break;
+          }
+        }
+        return std::string_view::npos;
+      }
+
+      Error JsonStream::completeValue(std::string_view value) {
+        Error error = Error::Success;
+        if(state_ == State::Value) {
+          error = memberHandler_(key_, value);
+          state_ = State::CommaOrEnd;
+        } else {
+          error = elementHandler_(key_, elementIndex_++, value);
+          state_ = State::ElementCommaOrEnd;
+        }
+        value_.clear();
+        isCapturing_ = false;
+        if(error.isFail()) {
+          return fail(MAKE_CHILD_ERROR(error, "Unable to handle json stream member \"%s\"", key_.c_str()));
+        }
+        return Error::Success;
+      }
+
+      Error JsonStream::append(std::string_view chunk) {
+        if(state_ == State::Failed) {
+          return MAKE_ERROR("Json stream has failed");
+        }
+        size_t i = 0;
+        while(i < chunk.size()) {
+          char c = chunk[i];
+          if(isCapturing_) {
+            size_t end = scanValue(chunk, i);
+            if(end == std::string_view::npos) {
+              value_.append(chunk.substr(i));
+              if(value_.size() > maxValueSize_) {
+                return fail(MAKE_ERROR("Json stream member \"%s\" is too large", key_.c_str()));
+              }
+              return Error::Success;
+            }
+            // the value_ is empty when the whole value is in this chunk
+            Error error = value_.empty() ? completeValue(chunk.substr(i, end - i)) : completeValue(value_.append(chunk.substr(i, end - i)));
+            if(error.isFail()) {
+              return error;
+            }
+            i = end;
+            continue;
+          }
+          if(isWhitespace(c) && state_ != State::InKey) {
+            i++;
+            continue;
+          }
+          if((state_ == State::Value || state_ == State::Element) && (c == ',' || c == ':' || c == '}' || c == ']')) {
+            return fail(MAKE_ERROR("Missing value of json stream member \"%s\"", key_.c_str()));
+          }
+          switch(state_) {
+            case State::BeforeObject:
+              if(c != '{') {
+                return fail(MAKE_ERROR("Json stream must be object"));
+              }
+              state_ = State::KeyOrEnd;
+              break;
+            case State::KeyOrEnd:
+            case State::Key:
+              if(c == '}' && state_ == State::KeyOrEnd) {
+                state_ = State::Done;
+                break;
+              }
+              if(c != '"') {
+                return fail(MAKE_ERROR("Unexpected '%c' instead of member name", c));
+              }
+              key_.clear();
+              isKeyEscaped_ = false;
+              state_ = State::InKey;
+              break;
+            case State::InKey: {
+              size_t end = i;
+              for(; end < chunk.size(); end++) {
+                if(isKeyEscaped_) {
+                  isKeyEscaped_ = false;
+                } else if(chunk[end] == '\\') {
+                  isKeyEscaped_ = true;
+                } else if(chunk[end] == '"') {
+                  break;
+                }
+              }
+              key_.append(chunk.substr(i, end - i));
+              if(key_.size() > maxValueSize_) {
+                return fail(MAKE_ERROR("Json stream member name is too large"));
+              }
+              if(end == chunk.size()) {
+                return Error::Success;
+              }
+              if(key_.find('\\') != std::string::npos && !JsonTape::unescape(key_)) {
+                return fail(MAKE_ERROR("Wrong escape in json stream member name"));
+              }
+              state_ = State::Colon;
+              i = end;
+              break;
+            }
+            case State::Colon:
+              if(c != ':') {
+                return fail(MAKE_ERROR("Unexpected '%c' after member name \"%s\"", c, key_.c_str()));
+              }
+              state_ = State::Value;
+              break;
+            case State::Value:
+              if(streamedArrays_.find(key_) != streamedArrays_.end()) {
+                if(c != '[') {
+                  return fail(MAKE_ERROR("Json stream member \"%s\" must be array", key_.c_str()));
+                }
+                elementIndex_ = 0;
+                state_ = State::ElementOrEnd;
+                break;
+              }
+              isCapturing_ = true;
+              continue;
+            case State::CommaOrEnd:
+              if(c == '}') {
+                state_ = State::Done;
+              } else if(c == ',') {
+                state_ = State::Key;
+              } else {
+                return fail(MAKE_ERROR("Unexpected '%c' after member \"%s\"", c, key_.c_str()));
+              }
+              break;
+            case State::ElementOrEnd:
+              if(c == ']') {
+                state_ = State::CommaOrEnd;
+                break;
+              }
+              // the element is checked for a missing value first
+              state_ = State::Element;
+              continue;
+            case State::Element:
+              isCapturing_ = true;
+              continue;
+            case State::ElementCommaOrEnd:
+              if(c == ']') {
+                state_ = State::CommaOrEnd;
+              } else if(c == ',') {
+                state_ = State::Element;
+              } else {
+                return fail(MAKE_ERROR("Unexpected '%c' in array \"%s\"", c, key_.c_str()));
+              }
+              break;
+            case State::Done:
+              return fail(MAKE_ERROR("Unexpected '%c' after json object", c));
+            case State::Failed:
+              return MAKE_ERROR("Json stream has failed");
+          }
+          i++;
+        }
+        return Error::Success;
+      }
+
+    } // namespace serializers
+  }   // namespace core
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+#include "core/common/error.h"
+
+  namespace core {
+    namespace serializers {
+
+      // resumable reader of a json object that arrives in chunks. Every top level member is handed over as
+      // soon as its value is complete, as raw json ready for a Deserializer. Members named as streamed arrays
+      // are handed over element by element, only the element being received is buffered. A value that ends
+      // inside the chunk it started in is passed as a view of the chunk without a copy. Names are unescaped
+      // before they are looked up in streamed arrays and handed over
+      class JsonStream {
+      public:
+        using MemberHandler = std::function<Error(std::string_view name, std::string_view value)>;
+        using ElementHandler = std::function<Error(std::string_view name, size_t index, std::string_view value)>;
+
+      public:
+        // the element handler may be empty when there are no streamed arrays
+        Error initialize(MemberHandler &&memberHandler, ElementHandler &&elementHandler, std::unordered_set<std::string> &&streamedArrays);
+        void reset();
+
+        // handlers are called from append, a failed handler stops the stream
+        Error append(std::string_view chunk);
+        // fails unless the whole object has been received
+        Error finish();
+        bool isComplete() const;
+
+        void setMaxValueSize(size_t size);
+
+      private:
+        enum class State {
+          BeforeObject,
+          KeyOrEnd,
+          Key,
+          InKey,
+          Colon,
+          Value,
+          CommaOrEnd,
+          ElementOrEnd,
+          Element,
+          ElementCommaOrEnd,
+          Done,
+          Failed
+        };
+
+        bool isWhitespace(char c) const;
+        // scans the current value, returns the position after it or npos when the chunk ends first
+        size_t scanValue(std::string_view chunk, size_t position);
+        Error completeValue(std::string_view value);
+        Error fail(Error &&error);
+
+      private:
+        MemberHandler memberHandler_;
+        ElementHandler elementHandler_;
+        std::unordered_set<std::string> streamedArrays_;
+        size_t maxValueSize_ = 16 * 1024 * 1024;
+        State state_ = State::BeforeObject;
+        std::string key_;
+        bool isKeyEscaped_ = false;
+        size_t elementIndex_ = 0;
+        // value in progress: bytes from earlier chunks, nesting and string state
+        std::string value_;
+        bool isCapturing_ = false;
+        size_t depth_ = 0;
+        bool isInString_ = false;
+        bool isEscaped_ = false;
+      };
+
+      inline bool JsonStream::isComplete() const {
+        return state_ == State::Done;
+      }
+      inline void JsonStream::setMaxValueSize(size_t size) {
+        maxValueSize_ = size;
+      }
+      inline bool JsonStream::isWhitespace(char c) const {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+      }
+
+    } // namespace serializers
+  }   // namespace core
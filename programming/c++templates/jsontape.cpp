@@ -0,0 +1,576 @@
+#include "jsontape.h"
+
+#include <array>
+#include <cstring>
+#include <string>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define JSONTAPE_X86 1
+#endif
+
+  namespace core {
+    namespace serializers {
+
+      namespace {
+        constexpr uint64_t EvenBits = 0x5555555555555555ull;
+
+        // bit masks of one 64 byte block
+        struct Block {
+          uint64_t backslash;
+          uint64_t quote;
+          uint64_t operators; // { } [ ] : ,
+          uint64_t whitespace;
+          uint64_t control;  // below 0x20
+          uint64_t nonAscii; // 0x80 and above
+        };
+
+        enum CharacterClass : uint8_t { Other, Backslash, Quote, Operator, Whitespace };
+
+        constexpr std::array<uint8_t, 256> characterClasses = []() {
+          std::array<uint8_t, 256> classes = {};
+          classes['\\'] = Backslash;
+          classes['"'] = Quote;
+          for(unsigned char c : {'{', '}', '[', ']', ':', ','}) {
+            classes[c] = Operator;
+          }
+          for(unsigned char c : {' ', '\t', '\n', '\r'}) {
+            classes[c] = Whitespace;
+          }
+          return classes;
+        }();
+
+        void classifyScalar(const unsigned char *data, Block &block) {
+          uint64_t masks[5] = {};
+          block.control = 0;
+          block.nonAscii = 0;
+          for(size_t i = 0; i < 64; i++) {
+            masks[characterClasses[data[i]]] |= 1ull << i;
+            block.control |= static_cast<uint64_t>(data[i] < 0x20) << i;
+            block.nonAscii |= static_cast<uint64_t>(data[i] >> 7) << i;
+          }
+          block.backslash = masks[Backslash];
+          block.quote = masks[Quote];
+          block.operators = masks[Operator];
+          block.whitespace = masks[Whitespace];
+        }
+
+#ifdef JSONTAPE_X86
+        __attribute__((target("sse4.2"))) uint64_t maskSse42(const unsigned char *data, char c) {
+          __m128i value = _mm_set1_epi8(c);
+          uint64_t mask = 0;
+          for(size_t i = 0; i < 4; i++) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * i));
+            mask |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, value)))) << (16 * i);
+          }
+          return mask;
+        }
+
+        __attribute__((target("sse4.2"))) void classifySse42(const unsigned char *data, Block &block) {
+          block.backslash = maskSse42(data, '\\');
+          block.quote = maskSse42(data, '"');
+          block.operators = maskSse42(data, '{') | maskSse42(data, '}') | maskSse42(data, '[') | maskSse42(data, ']') | maskSse42(data, ':') | maskSse42(data, ',');
+          block.whitespace = maskSse42(data, ' ') | maskSse42(data, '\t') | maskSse42(data, '\n') | maskSse42(data, '\r');
+          const __m128i controlMax = _mm_set1_epi8(0x1f);
+          block.control = 0;
+          block.nonAscii = 0;
+          for(size_t i = 0; i < 4; i++) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * i));
+            block.control |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(chunk, controlMax), chunk)))) << (16 * i);
+            block.nonAscii |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(chunk))) << (16 * i);
+          }
+        }
+
+        // both nibbles of a byte are looked up and the results anded, a bit set in both tables marks the class:
+        // 1 braces, 2 brackets, 4 colon, 8 comma, 16 space, 32 tab, line feed and carriage return
+        __attribute__((target("avx2"))) void classifyAvx2(const unsigned char *data, Block &block) {
+          const __m256i lowTable = _mm256_setr_epi8(
+              16, 0, 0, 0, 0, 0, 0, 0, 0, 32, 4 | 32, 1 | 2, 8, 1 | 2 | 32, 0, 0, 16, 0, 0, 0, 0, 0, 0, 0, 0, 32, 4 | 32, 1 | 2, 8, 1 | 2 | 32, 0, 0);
+          const __m256i highTable = _mm256_setr_epi8(
+              32, 0, 8 | 16, 4, 0, 2, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 32, 0, 8 | 16, 4, 0, 2, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0);
+          const __m256i lowNibble = _mm256_set1_epi8(0x0f);
+          const __m256i zero = _mm256_setzero_si256();
+          const __m256i operatorBits = _mm256_set1_epi8(0x0f);
+          const __m256i whitespaceBits = _mm256_set1_epi8(0x30);
+          const __m256i backslash = _mm256_set1_epi8('\\');
+          const __m256i quote = _mm256_set1_epi8('"');
+          const __m256i controlMax = _mm256_set1_epi8(0x1f);
+          block = {};
+          for(size_t i = 0; i < 2; i++) {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + 32 * i));
+            __m256i low = _mm256_shuffle_epi8(lowTable, _mm256_and_si256(chunk, lowNibble));
+            __m256i high = _mm256_shuffle_epi8(highTable, _mm256_and_si256(_mm256_srli_epi16(chunk, 4), lowNibble));
+            __m256i classes = _mm256_and_si256(low, high);
+            uint64_t operators = static_cast<uint32_t>(~_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(classes, operatorBits), zero)));
+            uint64_t whitespace = static_cast<uint32_t>(~_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(classes, whitespaceBits), zero)));
+            block.operators |= operators << (32 * i);
+            block.whitespace |= whitespace << (32 * i);
+            block.backslash |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, backslash)))) << (32 * i);
+            block.quote |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, quote)))) << (32 * i);
+            block.control |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(chunk, controlMax), chunk)))) << (32 * i);
+            block.nonAscii |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(chunk))) << (32 * i);
+          }
+        }
+#endif
+
+        // characters preceded by an odd run of backslashes, the carry is set when the block ends inside such a run
+        uint64_t escapedCharacters(uint64_t backslash, uint64_t &isEscapedCarry) {
+          backslash &= ~isEscapedCarry;
+          uint64_t followsEscape = (backslash << 1) | isEscapedCarry;
+          uint64_t oddSequenceStarts = backslash & ~EvenBits & ~followsEscape;
+          uint64_t sequencesStartingOnEvenBits;
+          isEscapedCarry = __builtin_add_overflow(oddSequenceStarts, backslash, &sequencesStartingOnEvenBits) ? 1 : 0;
+          uint64_t invertMask = sequencesStartingOnEvenBits << 1;
+          return (EvenBits ^ invertMask) & followsEscape;
+        }
+
+        uint64_t prefixXor(uint64_t bits) {
+          bits ^= bits << 1;
+          bits ^= bits << 2;
+          bits ^= bits << 4;
+          bits ^= bits << 8;
+          bits ^= bits << 16;
+          bits ^= bits << 32;
+          return bits;
+        }
+
+        bool isDigit(char c) {
+          return c >= '0' && c <= '9';
+        }
+
+        int hexDigit(char c) {
+          if(c >= '0' && c <= '9') {
+            return c - '0';
+          }
+          if(c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+          }
+          if(c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+          }
+          return -1;
+        }
+
+        // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+        bool isNumber(std::string_view text) {
+          size_t i = 0;
+          if(i < text.size() && text[i] == '-') {
+            i++;
+          }
+          if(i == text.size() || !isDigit(text[i])) {
+            return false;
+          }
+          if(text[i++] != '0') {
+            while(i < text.size() && isDigit(text[i])) {
+              i++;
+            }
+          }
+          if(i < text.size() && text[i] == '.') {
+            i++;
+            if(i == text.size() || !isDigit(text[i])) {
+              return false;
+            }
+            while(i < text.size() && isDigit(text[i])) {
+              i++;
+            }
+          }
+          if(i < text.size() && (text[i] == 'e' || text[i] == 'E')) {
+            i++;
+            if(i < text.size() && (text[i] == '+' || text[i] == '-')) {
+              i++;
+            }
+            if(i == text.size() || !isDigit(text[i])) {
+              return false;
+            }
+            while(i < text.size() && isDigit(text[i])) {
+              i++;
+            }
+          }
+          return i == text.size();
+        }
+
+        // code point of the four hex digits at text[i], -1 when they are not
+        int32_t hexCodePoint(std::string_view text, size_t i) {
+          if(i + 4 > text.size()) {
+            return -1;
+          }
+          int32_t value = 0;
+          for(size_t j = i; j < i + 4; j++) {
+            int digit = hexDigit(text[j]);
+            if(digit < 0) {
+              return -1;
+            }
+            value = value * 16 + digit;
+          }
+          return value;
+        }
+
+        // length of the well formed utf-8 sequence at text[i], 0 when it is not: no overlong forms, surrogates
+        // or code points above U+10FFFF
+        size_t utf8Length(std::string_view text, size_t i) {
+          unsigned char c = static_cast<unsigned char>(text[i]);
+          size_t length;
+          unsigned char low = 0x80;
+          unsigned char high = 0xbf;
+          if(c >= 0xc2 && c <= 0xdf) {
+            length = 2;
+          } else if(c >= 0xe0 && c <= 0xef) {
+            length = 3;
+            low = c == 0xe0 ? 0xa0 : 0x80;
+            high = c == 0xed ? 0x9f : 0xbf;
+          } else if(c >= 0xf0 && c <= 0xf4) {
+            length = 4;
+            low = c == 0xf0 ? 0x90 : 0x80;
+            high = c == 0xf4 ? 0x8f : 0xbf;
+          } else {
+            return 0;
+          }
+          if(i + length > text.size()) {
+            return 0;
+          }
+          for(size_t j = i + 1; j < i + length; j++) {
+            unsigned char next = static_cast<unsigned char>(text[j]);
+            if(next < low || next > high) {
+              return 0;
+            }
+            low = 0x80;
+            high = 0xbf;
+          }
+          return length;
+        }
+
+        // the escape at position is the character after a backslash inside a string. A low surrogate is only
+        // valid at lowSurrogate, the position set by the high surrogate before it
+        Error checkEscape(std::string_view source, size_t position, size_t &lowSurrogate) {
+          char c = position < source.size() ? source[position] : 0;
+          switch(c) {
+            case '"':
+            case '\\':
+            case '/':
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+              return Error::Success;
+            case 'u':
+              break;
+            default:
+              return MAKE_ERROR("Wrong escape at %zu", position - 1);
+          }
+          int32_t codePoint = hexCodePoint(source, position + 1);
+          if(codePoint < 0) {
+            return MAKE_ERROR("Wrong escape at %zu", position - 1);
+          }
+          if(codePoint >= 0xdc00 && codePoint <= 0xdfff) {
+            if(position != lowSurrogate) {
+              return MAKE_ERROR("Unpaired surrogate at %zu", position - 1);
+            }
+          } else if(codePoint >= 0xd800 && codePoint <= 0xdbff) {
+            int32_t low = source.substr(position + 5, 2) == "\\u" ? hexCodePoint(source, position + 7) : -1;
+            if(low < 0xdc00 || low > 0xdfff) {
+              return MAKE_ERROR("Unpaired surrogate at %zu", position - 1);
+            }
+            lowSurrogate = position + 6;
+          }
+          return Error::Success;
+        }
+
+        Error checkUtf8(std::string_view source, size_t position) {
+          while(position < source.size()) {
+            if(static_cast<unsigned char>(source[position]) < 0x80) {
+              position++;
+              continue;
+            }
+            size_t length = utf8Length(source, position);
+            if(length == 0) {
+              return MAKE_ERROR("Wrong utf-8 at %zu", position);
+            }
+            position += length;
+          }
+          return Error::Success;
+        }
+
+        template <void (*Classify)(const unsigned char *, Block &)>
+        Error indexBlocks(std::string_view source, std::vector<uint32_t> &indexes) {
+          indexes.clear();
+          indexes.reserve(source.size() / 4 + 1);
+          uint64_t isEscapedCarry = 0;
+          uint64_t inStringCarry = 0;
+          uint64_t scalarCarry = 0;
+          size_t lowSurrogate = std::string_view::npos;
+          size_t firstNonAscii = std::string_view::npos;
+          const unsigned char *data = reinterpret_cast<const unsigned char *>(source.data());
+          unsigned char tail[64];
+          for(size_t offset = 0; offset < source.size(); offset += 64) {
+            const unsigned char *block = data + offset;
+            if(source.size() - offset < 64) {
+              std::memset(tail, ' ', sizeof(tail));
+              std::memcpy(tail, block, source.size() - offset);
+              block = tail;
+            }
+            Block masks;
+            Classify(block, masks);
+            uint64_t escaped = escapedCharacters(masks.backslash, isEscapedCarry);
+            uint64_t quotes = masks.quote & ~escaped;
+            // from the opening quote up to the character before the closing one
+            uint64_t inString = prefixXor(quotes) ^ inStringCarry;
+            inStringCarry = static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+            if(uint64_t control = masks.control & inString) {
+              return MAKE_ERROR("Control character in string at %zu", offset + static_cast<size_t>(__builtin_ctzll(control)));
+            }
+            // escapes are rare, they are checked one by one
+            for(uint64_t escapes = escaped & inString; escapes; escapes &= escapes - 1) {
+              Error error = checkEscape(source, offset + static_cast<size_t>(__builtin_ctzll(escapes)), lowSurrogate);
+              if(error.isFail()) {
+                return error;
+              }
+            }
+            if(masks.nonAscii && firstNonAscii == std::string_view::npos) {
+              firstNonAscii = offset;
+            }
+            uint64_t scalar = ~(masks.operators | masks.whitespace);
+            uint64_t nonQuoteScalar = scalar & ~quotes;
+            uint64_t followsNonQuoteScalar = (nonQuoteScalar << 1) | scalarCarry;
+            scalarCarry = nonQuoteScalar >> 63;
+            uint64_t stringTail = inString ^ quotes;
+            uint64_t structurals = (masks.operators | (scalar & ~followsNonQuoteScalar)) & ~stringTail;
+            while(structurals) {
+              indexes.push_back(static_cast<uint32_t>(offset + static_cast<size_t>(__builtin_ctzll(structurals))));
+              structurals &= structurals - 1;
+            }
+          }
+          if(inStringCarry) {
+            return MAKE_ERROR("Unterminated string");
+          }
+          // the blocks before are ascii, so a sequence does not start before firstNonAscii
+          if(firstNonAscii != std::string_view::npos) {
+            return checkUtf8(source, firstNonAscii);
+          }
+          return Error::Success;
+        }
+
+      } // namespace
+
+      JsonTape::Backend JsonTape::bestBackend() {
+#ifdef JSONTAPE_X86
+        static const Backend backend = __builtin_cpu_supports("avx2") ? Backend::Avx2 : __builtin_cpu_supports("sse4.2") ? Backend::Sse42 : Backend::Scalar;
+        return backend;
+#else
+        return Backend::Scalar;
+#endif
+      }
+
+      Error JsonTape::index(std::string_view source, std::vector<uint32_t> &indexes, Backend backend) {
+        if(source.size() >= UINT32_MAX) {
+          return MAKE_ERROR("Json document is too large");
+        }
+        if(backend == Backend::Auto) {
+          backend = bestBackend();
+        }
+        switch(backend) {
+#ifdef JSONTAPE_X86
+          case Backend::Avx2:
+            return indexBlocks<classifyAvx2>(source, indexes);
+          case Backend::Sse42:
+            return indexBlocks<classifySse42>(source, indexes);
+#endif
+          default:
+            return indexBlocks<classifyScalar>(source, indexes);
+        }
+      }
+
+      Error JsonTape::parse(std::string_view source, Backend backend) {
+        source_ = source;
+        entries_.clear();
+        Error error = index(source, indexes_, backend);
+        if(error.isFail()) {
+          return MAKE_CHILD_ERROR(error, "Unable to parse json");
+        }
+        error = build();
+        if(error.isFail()) {
+          return MAKE_CHILD_ERROR(error, "Unable to parse json");
+        }
+        return Error::Success;
+      }
+
+      bool JsonTape::unescape(std::string &text) {
+        size_t out = 0;
+        for(size_t i = 0; i < text.size(); i++) {
+          if(text[i] != '\\') {
+            text[out++] = text[i];
+            continue;
+          }
+          if(++i == text.size()) {
+            return false;
+          }
+          switch(text[i]) {
+            case '"':
+            case '\\':
+            case '/':
+              text[out++] = text[i];
+              continue;
+            case 'b':
+              text[out++] = '\b';
+              continue;
+            case 'f':
+              text[out++] = '\f';
+              continue;
+            case 'n':
+              text[out++] = '\n';
+              continue;
+            case 'r':
+              text[out++] = '\r';
+              continue;
+            case 't':
+              text[out++] = '\t';
+              continue;
+            case 'u':
+              break;
+            default:
+              return false;
+          }
+          int32_t codePoint = hexCodePoint(text, i + 1);
+          if(codePoint < 0 || (codePoint >= 0xdc00 && codePoint <= 0xdfff)) {
+            return false;
+          }
+          i += 4;
+          if(codePoint >= 0xd800 && codePoint <= 0xdbff) {
+            int32_t low = i + 2 < text.size() && text[i + 1] == '\\' && text[i + 2] == 'u' ? hexCodePoint(text, i + 3) : -1;
+            if(low < 0xdc00 || low > 0xdfff) {
+              return false;
+            }
+            codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+            i += 6;
+          }
+          if(codePoint < 0x80) {
+            text[out++] = static_cast<char>(codePoint);
+          } else if(codePoint < 0x800) {
+            text[out++] = static_cast<char>(0xc0 | (codePoint >> 6));
+            text[out++] = static_cast<char>(0x80 | (codePoint & 0x3f));
+          } else if(codePoint < 0x10000) {
+            text[out++] = static_cast<char>(0xe0 | (codePoint >> 12));
+            text[out++] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+            text[out++] = static_cast<char>(0x80 | (codePoint & 0x3f));
+          } else {
+            text[out++] = static_cast<char>(0xf0 | (codePoint >> 18));
+            text[out++] = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+            text[out++] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+            text[out++] = static_cast<char>(0x80 | (codePoint & 0x3f));
+          }
+        }
+        text.resize(out);
+        return true;
+      }
+
+      // end of a string or scalar starting at position, the structural after it bounds the search
+      size_t JsonTape::scalarEnd(size_t position, size_t nextStructural) const {
+        size_t end = nextStructural;
+        while(end > position + 1 && (source_[end - 1] == ' ' || source_[end - 1] == '\t' || source_[end - 1] == '\n' || source_[end - 1] == '\r')) {
+          end--;
+        }
+        return end;
+      }
+
+      Error JsonTape::build() {
+        enum class Expect { Value, KeyOrEnd, Key, Colon, ValueOrEnd, CommaOrEnd };
+        entries_.reserve(indexes_.size());
+        stack_.clear();
+        Expect expect = Expect::Value;
+        bool isDone = false;
+        for(size_t i = 0; i < indexes_.size(); i++) {
+          size_t position = indexes_[i];
+          size_t nextStructural = i + 1 < indexes_.size() ? indexes_[i + 1] : source_.size();
+          char c = source_[position];
+          if(isDone) {
+            return MAKE_ERROR("Unexpected '%c' at %zu after the document", c, position);
+          }
+          bool isInObject = !stack_.empty() && entries_[stack_.back()].type == Type::StartObject;
+          switch(c) {
+            case '{':
+            case '[':
+              if(expect != Expect::Value && expect != Expect::ValueOrEnd) {
+                return MAKE_ERROR("Unexpected '%c' at %zu", c, position);
+              }
+              stack_.push_back(static_cast<uint32_t>(entries_.size()));
+              entries_.push_back({c == '{' ? Type::StartObject : Type::StartArray, static_cast<uint32_t>(position), 0});
+              expect = c == '{' ? Expect::KeyOrEnd : Expect::ValueOrEnd;
+              continue;
+            case '}':
+            case ']': {
+              Type start = c == '}' ? Type::StartObject : Type::StartArray;
+              if(stack_.empty() || entries_[stack_.back()].type != start || (expect != Expect::CommaOrEnd && expect != (c == '}' ? Expect::KeyOrEnd : Expect::ValueOrEnd))) {
+                return MAKE_ERROR("Unexpected '%c' at %zu", c, position);
+              }
+              uint32_t open = stack_.back();
+              stack_.pop_back();
+              entries_[open].link = static_cast<uint32_t>(entries_.size());
+              entries_.push_back({c == '}' ? Type::EndObject : Type::EndArray, static_cast<uint32_t>(position), open});
+              break;
+            }
+            case ':':
+              if(expect != Expect::Colon) {
+                return MAKE_ERROR("Unexpected ':' at %zu", position);
+              }
+              expect = Expect::Value;
+              continue;
+            case ',':
+              if(expect != Expect::CommaOrEnd) {
+                return MAKE_ERROR("Unexpected ',' at %zu", position);
+              }
+              expect = isInObject ? Expect::Key : Expect::Value;
+              continue;
+            case '"': {
+              size_t end = scalarEnd(position, nextStructural);
+              if(end - position < 2 || source_[end - 1] != '"') {
+                return MAKE_ERROR("Wrong string at %zu", position);
+              }
+              entries_.push_back({Type::String, static_cast<uint32_t>(position), static_cast<uint32_t>(end - position)});
+              if(expect == Expect::Key || expect == Expect::KeyOrEnd) {
+                expect = Expect::Colon;
+                continue;
+              }
+              if(expect != Expect::Value && expect != Expect::ValueOrEnd) {
+                return MAKE_ERROR("Unexpected string at %zu", position);
+              }
+              break;
+            }
+            default: {
+              if(expect != Expect::Value && expect != Expect::ValueOrEnd) {
+                return MAKE_ERROR("Unexpected '%c' at %zu", c, position);
+              }
+              size_t end = scalarEnd(position, nextStructural);
+              std::string_view text = source_.substr(position, end - position);
+              Type type;
+              if(text == "true") {
+                type = Type::True;
+              } else if(text == "false") {
+                type = Type::False;
+              } else if(text == "null") {
+                type = Type::Null;
+              } else if(isNumber(text)) {
+                type = Type::Number;
+              } else if(c == '-' || isDigit(c)) {
+                return MAKE_ERROR("Wrong number at %zu", position);
+              } else {
+                return MAKE_ERROR("Unexpected '%c' at %zu", c, position);
+              }
+              entries_.push_back({type, static_cast<uint32_t>(position), static_cast<uint32_t>(end - position)});
+              break;
+            }
+          }
+          // a value is complete
+          if(stack_.empty()) {
+            isDone = true;
+          } else {
+            expect = Expect::CommaOrEnd;
+          }
+        }
+        if(!isDone) {
+          return MAKE_ERROR("Unexpected end of json");
+        }
+        return Error::Success;
+      }
+
+    } // namespace serializers
+  }   // namespace core
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "core/common/error.h"
+
+  namespace core {
+    namespace serializers {
+
+      // two stage json parser. The first stage classifies the source 64 bytes at a time with AVX2, SSE4.2 or
+      // scalar code and keeps the positions of structural characters, string and scalar starts outside
+      // strings. The second stage walks these positions, checks the grammar, number syntax, escapes and utf-8
+      // of strings and writes a flat tape of entries where every container knows where it ends. Strings stay
+      // escaped, numbers unparsed: both point into the source, which must outlive the tape
+      class JsonTape {
+      public:
+        enum class Backend {
+          Auto = 0,
+          Scalar = 1,
+          Sse42 = 2,
+          Avx2 = 3
+        };
+
+        enum class Type : uint8_t {
+          StartObject,
+          EndObject,
+          StartArray,
+          EndArray,
+          String,
+          Number,
+          True,
+          False,
+          Null
+        };
+
+        struct Entry {
+          Type type;
+          uint32_t position;
+          // containers: tape index of the matching entry, scalars: length in the source. String length
+          // includes the quotes
+          uint32_t link;
+        };
+
+      public:
+        Error parse(std::string_view source, Backend backend = Backend::Auto);
+
+        const std::vector<Entry> &entries() const;
+        std::string_view source() const;
+        // raw text of a scalar, strings without the quotes and still escaped
+        std::string_view text(size_t index) const;
+        // index of the entry after the value at index, containers are skipped as a whole
+        size_t next(size_t index) const;
+
+        // first stage only, exposed for benchmarks
+        static Error index(std::string_view source, std::vector<uint32_t> &indexes, Backend backend = Backend::Auto);
+        static Backend bestBackend();
+        // decodes the escapes of a json string in place, utf-8 of a code point is never longer than its escape
+        static bool unescape(std::string &text);
+
+      private:
+        Error build();
+        size_t scalarEnd(size_t position, size_t nextStructural) const;
+
+      private:
+        std::string_view source_;
+        std::vector<uint32_t> indexes_;
+        std::vector<Entry> entries_;
+        std::vector<uint32_t> stack_;
+      };
+
+      inline const std::vector<JsonTape::Entry> &JsonTape::entries() const {
+        return entries_;
+      }
+      inline std::string_view JsonTape::source() const {
+        return source_;
+      }
+      inline std::string_view JsonTape::text(size_t index) const {
+        const Entry &entry = entries_[index];
+        if(entry.type == Type::String) {
+          return source_.substr(entry.position + 1, entry.link - 2);
+        }
+        return source_.substr(entry.position, entry.link);
+      }
+      inline size_t JsonTape::next(size_t index) const {
+        const Entry &entry = entries_[index];
+        if(entry.type == Type::StartObject || entry.type == Type::StartArray) {
+          return entry.link + 1;
+        }
+        return index + 1;
+      }
+
+    } // namespace serializers
+  }   // namespace core
@@ -0,0 +1,118 @@
+#include "jsontapedeserializer.h"
+
+#include <charconv>
+#include <cstdint>
+
+  namespace core {
+    namespace serializers {
+
+      JsonTapeDeserializer::JsonTapeDeserializer(std::string_view source, JsonTape::Backend backend) : Deserializer(source) {
+        error_ = tape_.parse(source, backend);
+      }
+
+      Deserializer::OperationResult JsonTapeDeserializer::deserializeNext() {
+        if(error_.isFail()) {
+          return OperationResult(OperationResult::Status::Fail);
+        }
+        const std::vector<JsonTape::Entry> &entries = tape_.entries();
+        if(index_ == entries.size()) {
+          return fail(MAKE_ERROR("Unexpected end of json at %zu", position_));
+        }
+        std::string_view name;
+        if(!isObject_.empty() && isObject_.back() && entries[index_].type != JsonTape::Type::EndObject) {
+          name = this->name(index_++);
+        }
+        const JsonTape::Entry &entry = entries[index_++];
+        switch(entry.type) {
+          case JsonTape::Type::StartObject:
+          case JsonTape::Type::StartArray:
+            isObject_.push_back(entry.type == JsonTape::Type::StartObject);
+            position_ = entry.position;
+            return OperationResult(OperationResult::Status::StartGroup, name);
+          case JsonTape::Type::EndObject:
+          case JsonTape::Type::EndArray:
+            isObject_.pop_back();
+            position_ = entry.position + 1;
+            return OperationResult(OperationResult::Status::EndGroup);
+          default:
+            break;
+        }
+        BasicValue value;
+        Error error = this->value(index_ - 1, value);
+        if(error.isFail()) {
+          return fail(std::move(error));
+        }
+        position_ = entry.position + entry.link;
+        return OperationResult(OperationResult::Status::Value, name, std::move(value));
+      }
+
+      Error JsonTapeDeserializer::getLastError() const {
+        return error_;
+      }
+
+      size_t JsonTapeDeserializer::currentPosition() const {
+        return position_;
+      }
+
+      std::span<const unsigned char> JsonTapeDeserializer::sourceData() const {
+        std::string_view source = tape_.source();
+        return std::span<const unsigned char>(reinterpret_cast<const unsigned char *>(source.data()), source.size());
+      }
+
+      Deserializer::OperationResult JsonTapeDeserializer::fail(Error &&error) {
+        error_ = std::move(error);
+        return OperationResult(OperationResult::Status::Fail);
+      }
+
+      // keys without escapes stay views of the source
+      std::string_view JsonTapeDeserializer::name(size_t index) {
+        std::string_view text = tape_.text(index);
+        if(text.find('\\') == std::string_view::npos) {
+          return text;
+        }
+        name_.assign(text);
+        JsonTape::unescape(name_);
+        return name_;
+      }
+
+      // the tape already checked escapes and number syntax, integers out of range become doubles and only
+      // numbers out of the range of a double fail
+      Error JsonTapeDeserializer::value(size_t index, BasicValue &out) const {
+        const JsonTape::Entry &entry = tape_.entries()[index];
+        std::string_view text = tape_.text(index);
+        switch(entry.type) {
+          case JsonTape::Type::String: {
+            std::string value(text);
+            if(text.find('\\') != std::string_view::npos) {
+              JsonTape::unescape(value);
+            }
+            out = BasicValue(std::move(value));
+            return Error::Success;
+          }
+          case JsonTape::Type::Number: {
+            if(text.find_first_of(".eE") == std::string_view::npos) {
+              int64_t value = 0;
+              if(std::from_chars(text.data(), text.data() + text.size(), value).ec == std::errc()) {
+                out = BasicValue(value);
+                return Error::Success;
+              }
+            }
+            double value = 0;
+            if(std::from_chars(text.data(), text.data() + text.size(), value).ec != std::errc()) {
+              return MAKE_ERROR("Number out of range at %u", entry.position);
+            }
+            out = BasicValue(value);
+            return Error::Success;
+          }
+          case JsonTape::Type::True:
+          case JsonTape::Type::False:
+            out = BasicValue(entry.type == JsonTape::Type::True);
+            return Error::Success;
+          default:
+            out = BasicValue();
+            return Error::Success;
+        }
+      }
+
+    } // namespace serializers
+  }   // namespace core
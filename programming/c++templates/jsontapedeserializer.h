@@ -0,0 +1,49 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "basicvalue.h"
+#include "core/common/error.h"
+#include "deserializer.h"
+#include "jsontape.h"
+
+  namespace core {
+    namespace serializers {
+
+      // Deserializer reading a JsonTape, so Serializable::deserialize and getBindings() of every message type
+      // run on the two stage parser unchanged. The whole source is checked when the deserializer is created and
+      // a malformed one fails the first event. Events then walk the tape: object keys come with the event of
+      // their value as its name, strings are unescaped, numbers without fraction or exponent are integers.
+      // The source must outlive the deserializer
+      class JsonTapeDeserializer : public Deserializer {
+      public:
+        explicit JsonTapeDeserializer(std::string_view source, JsonTape::Backend backend = JsonTape::Backend::Auto);
+
+        OperationResult deserializeNext() override;
+        Error getLastError() const override;
+        // at the opening bracket after the start of a group and after the event otherwise, the text of a group
+        // lies between the position after its start and the one after its end
+        size_t currentPosition() const override;
+        std::span<const unsigned char> sourceData() const override;
+
+      private:
+        OperationResult fail(Error &&error);
+        std::string_view name(size_t index);
+        Error value(size_t index, BasicValue &out) const;
+
+      private:
+        JsonTape tape_;
+        Error error_ = Error::Success;
+        size_t index_ = 0;
+        size_t position_ = 0;
+        // one per open container, true for objects where every event but the end starts with a key
+        std::vector<bool> isObject_;
+        // unescaped name of the last event when its key had escapes
+        std::string name_;
+      };
+
+    } // namespace serializers
+  }   // namespace core
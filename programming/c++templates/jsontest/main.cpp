@@ -0,0 +1,266 @@
+#include "deserializer.h"
+#include "jsonstream.h"
+#include "jsontape.h"
+#include "jsontapedeserializer.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// JsonTape of every backend the cpu supports against malformed documents and, on well formed ones, against
+// each other and against the events of Deserializer. JsonTapeDeserializer against the events, names and
+// positions of Deserializer. JsonStream with escaped member names. Built the same way as jsonbench
+//
+//   jsontest
+
+using namespace core::serializers;
+
+namespace {
+  std::vector<JsonTape::Backend> backends() {
+    std::vector<JsonTape::Backend> backends = {JsonTape::Backend::Scalar};
+    if(JsonTape::bestBackend() >= JsonTape::Backend::Sse42) {
+      backends.push_back(JsonTape::Backend::Sse42);
+    }
+    if(JsonTape::bestBackend() >= JsonTape::Backend::Avx2) {
+      backends.push_back(JsonTape::Backend::Avx2);
+    }
+    return backends;
+  }
+
+  bool isSameTape(const JsonTape &left, const JsonTape &right) {
+    if(left.entries().size() != right.entries().size()) {
+      return false;
+    }
+    for(size_t i = 0; i < left.entries().size(); i++) {
+      const JsonTape::Entry &l = left.entries()[i];
+      const JsonTape::Entry &r = right.entries()[i];
+      if(l.type != r.type || l.position != r.position || l.link != r.link) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // containers open and close groups of the deserializer, scalars other than object keys are its values
+  const char *compareWithDeserializer(const JsonTape &tape) {
+    struct Container {
+      bool isObject;
+      bool isKeyNext;
+    };
+    Deserializer deserializer(tape.source());
+    std::vector<Container> containers;
+    for(const JsonTape::Entry &entry : tape.entries()) {
+      if(!containers.empty() && containers.back().isKeyNext && entry.type == JsonTape::Type::String) {
+        containers.back().isKeyNext = false;
+        continue;
+      }
+      Deserializer::OperationResult::Status expected = Deserializer::OperationResult::Status::Value;
+      if(entry.type == JsonTape::Type::StartObject || entry.type == JsonTape::Type::StartArray) {
+        expected = Deserializer::OperationResult::Status::StartGroup;
+      } else if(entry.type == JsonTape::Type::EndObject || entry.type == JsonTape::Type::EndArray) {
+        expected = Deserializer::OperationResult::Status::EndGroup;
+      }
+      if(deserializer.deserializeNext().status() != expected) {
+        return "tape differs from the deserializer";
+      }
+      if(expected == Deserializer::OperationResult::Status::StartGroup) {
+        containers.push_back({entry.type == JsonTape::Type::StartObject, entry.type == JsonTape::Type::StartObject});
+        continue;
+      }
+      if(expected == Deserializer::OperationResult::Status::EndGroup) {
+        containers.pop_back();
+      }
+      // a member value is complete
+      if(!containers.empty() && containers.back().isObject) {
+        containers.back().isKeyNext = true;
+      }
+    }
+    return nullptr;
+  }
+
+  // same events with the same names, groups start and end at the same positions so raw json members agree
+  const char *compareDeserializers(const std::string &document, JsonTape::Backend backend) {
+    Deserializer deserializer(document);
+    JsonTapeDeserializer tapeDeserializer(document, backend);
+    size_t depth = 0;
+    do {
+      Deserializer::OperationResult expected = deserializer.deserializeNext();
+      Deserializer::OperationResult result = tapeDeserializer.deserializeNext();
+      if(result.status() == Deserializer::OperationResult::Status::Fail) {
+        return tapeDeserializer.getLastError().message();
+      }
+      if(result.status() != expected.status() || result.name() != expected.name()) {
+        return "tape deserializer differs from the deserializer";
+      }
+      if(result.status() == Deserializer::OperationResult::Status::StartGroup) {
+        depth++;
+      } else if(result.status() == Deserializer::OperationResult::Status::EndGroup) {
+        depth--;
+      } else {
+        continue;
+      }
+      if(tapeDeserializer.currentPosition() != deserializer.currentPosition()) {
+        return "tape deserializer position differs from the deserializer";
+      }
+    } while(depth > 0);
+    return nullptr;
+  }
+
+  std::string longDocument() {
+    std::string document = "{\"members\":[";
+    for(size_t i = 0; i < 64; i++) {
+      document += i ? "," : "";
+      // escapes and multibyte characters land on every offset of the 64 byte blocks
+      document += "{\"id\":" + std::to_string(i) + ",\"name\":\"" + std::string(i % 7, 'x') + "\\\"\\\\\\u00e9\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80\\ud83d\\ude00\",\"score\":-" +
+                  std::to_string(i) + ".5e+" + std::to_string(i % 3) + ",\"flags\":[true,false,null]}";
+    }
+    document += "]}";
+    return document;
+  }
+  size_t checkTape() {
+    const std::string valid[] = {
+        "{}",
+        "[]",
+        "0",
+        "-0.0e0",
+        "\"\"",
+        " {\"a\" : [1, -2.5, 3E+10, 0.001e-3] , \"b\":{\"c\":null}} ",
+        "[\"\\/\\b\\f\\n\\r\\t\", \"\\uD834\\uDD1E\", \"\xf4\x8f\xbf\xbf\"]",
+        "[[[]],[{}],{\"\":[]}]",
+        longDocument(),
+    };
+    const std::string invalid[] = {
+        "[1\"a\"]",
+        "[true\"a\"]",
+        "[1 2]",
+        "{\"a\" 1}",
+        "{\"a\":1 \"b\":2}",
+        "[[1][2]]",
+        "{\"a\":1,}",
+        "[1,]",
+        "{1:2}",
+        "[01]",
+        "[1.]",
+        "[.5]",
+        "[1e]",
+        "[-]",
+        "[+1]",
+        "[0x10]",
+        "[1.5.5]",
+        "[tru]",
+        "[\"\\x\"]",
+        "[\"\\u12g4\"]",
+        "[\"\\ud800\"]",
+        "[\"\\udc00\"]",
+        "[\"\\ud800\\u0041\"]",
+        std::string("[\"a\tb\"]"),
+        std::string("[\"a\nb\"]"),
+        std::string("[\"a\x01") + "b\"]",
+        "[\"\xc0\xaf\"]",
+        "[\"\xed\xa0\x80\"]",
+        "[\"\xf5\x80\x80\x80\"]",
+        "[\"\xe2\x82\"]",
+        "[\"\x80\"]",
+        "[\"a\"",
+        "{\"a\":1}}",
+        "{}{}",
+        "",
+    };
+    size_t failed = 0;
+    for(JsonTape::Backend backend : backends()) {
+      for(const std::string &document : valid) {
+        JsonTape tape;
+        JsonTape scalar;
+        Error error = tape.parse(document, backend);
+        const char *failure = nullptr;
+        if(error.isFail()) {
+          failure = error.message();
+        } else if(scalar.parse(document, JsonTape::Backend::Scalar).isFail() || !isSameTape(tape, scalar)) {
+          failure = "tape differs from scalar";
+        } else {
+          failure = compareWithDeserializer(tape);
+        }
+        if(!failure) {
+          failure = compareDeserializers(document, backend);
+        }
+        if(failure) {
+          std::printf("backend %d, valid %.40s: %s\n", static_cast<int>(backend), document.c_str(), failure);
+          failed++;
+        }
+      }
+      for(const std::string &document : invalid) {
+        JsonTape tape;
+        if(tape.parse(document, backend).isSuccess()) {
+          std::printf("backend %d, invalid %.40s: parsed\n", static_cast<int>(backend), document.c_str());
+          failed++;
+        }
+        // the whole source is checked before the first event
+        JsonTapeDeserializer deserializer(document, backend);
+        if(deserializer.deserializeNext().status() != Deserializer::OperationResult::Status::Fail || deserializer.getLastError().isSuccess()) {
+          std::printf("backend %d, invalid %.40s: first event of the tape deserializer\n", static_cast<int>(backend), document.c_str());
+          failed++;
+        }
+      }
+    }
+    return failed;
+  }
+
+  // names reach the handlers unescaped, a streamed array named with escapes is still streamed, an array
+  // element that is missing fails
+  size_t checkStream() {
+    size_t failed = 0;
+    JsonStream stream;
+    Error error = stream.initialize(
+        [](std::string_view, std::string_view) -> Error {
+          return Error::Success;
+        },
+        nullptr,
+        {"members"});
+    if(error.isSuccess()) {
+      std::printf("stream without element handler: initialized\n");
+      failed++;
+    }
+    std::vector<std::string> names;
+    size_t elements = 0;
+    error = stream.initialize(
+        [&names](std::string_view name, std::string_view) -> Error {
+          names.emplace_back(name);
+          return Error::Success;
+        },
+        [&elements](std::string_view name, size_t, std::string_view) -> Error {
+          elements += name == "members";
+          return Error::Success;
+        },
+        {"members"});
+    const char *chunks[] = {"{\"group\\u005fid\":1,\"mem\\u", "0062ers\":[{\"id\":1},{\"id\":2}],\"\\u00e9\\ud83d\\ude00\\n\":true}"};
+    for(const char *chunk : chunks) {
+      if(error.isSuccess()) {
+        error = stream.append(chunk);
+      }
+    }
+    if(error.isSuccess()) {
+      error = stream.finish();
+    }
+    if(error.isFail()) {
+      std::printf("stream with escaped names: %s\n", error.message());
+      failed++;
+    } else if(elements != 2 || names.size() != 2 || names[0] != "group_id" || names[1] != "\xc3\xa9\xf0\x9f\x98\x80\n") {
+      std::printf("stream with escaped names: names are not unescaped\n");
+      failed++;
+    }
+    for(const char *document : {"{\"a\\x\":1}", "{\"\\ud800\":1}", "{\"\\u00g0\":1}", "{\"members\":[,1]}", "{\"members\":[:1]}", "{\"members\":[1,]}"}) {
+      stream.reset();
+      if(stream.append(document).isSuccess()) {
+        std::printf("stream %s: parsed\n", document);
+        failed++;
+      }
+    }
+    return failed;
+  }
+} // namespace
+
+int main() {
+  size_t failed = checkTape() + checkStream();
+  std::printf("%zu failed\n", failed);
+  return failed == 0 ? 0 : 1;
+}
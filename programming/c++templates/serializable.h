@@ -1,8 +1,16 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
 #include <functional>
+#include <limits>
 #include <map>
+#include <memory_resource>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "basicvalue.h"
 #include "core/common/error.h"
@@ -13,6 +21,18 @@
   namespace core {
     namespace serializers {
 
+      // string literal usable as a template argument, names of SerializedMember
+      template <size_t N>
+      struct SerializedMemberName {
+        constexpr SerializedMemberName(const char (&name)[N]) {
+          std::copy_n(name, N, value);
+        }
+        constexpr std::string_view view() const {
+          return std::string_view(value, N - 1);
+        }
+        char value[N];
+      };
+
       class Serializable {
       public:
         enum class Flag {
@@ -41,51 +61,122 @@
         };
 
         struct SerializableMembers {
+          static constexpr size_t NotFound = std::numeric_limits<size_t>::max();
           SerializableMembers(const std::vector<SerializableMemberInfo> &members);
           std::vector<SerializableMemberInfo> binds;
           std::map<std::string, size_t, std::less<>> index;
+          // set by SerializedMemberTable, lookups and handlers then bypass index and the std::function of binds
+          size_t (*lookup)(std::string_view name) = nullptr;
+          Error (*serializeMembers)(const Serializable *_this, Serializer *serializer) = nullptr;
+          Error (*deserializeMember)(Serializable *_this, Deserializer *deserializer, size_t index) = nullptr;
+          size_t find(std::string_view name) const;
+          Error serialize(const Serializable *_this, Serializer *serializer) const;
+          Error deserialize(Serializable *_this, Deserializer *deserializer, size_t index) const;
           SerializableMembers operator+(const SerializableMembers &other) const;
+          // parent members followed by other, looked up through index: the table functions of a parent only
+          // know the members of the parent
+          static SerializableMembers inherit(const SerializableMembers &parent, const SerializableMembers &other);
         };
 
+        // one member of a SerializedMemberTable. The name, the member and its flags are template arguments, so
+        // the handlers are plain functions compiled for this member. A missing value becomes a value initialized M
+        template <SerializedMemberName Name, auto Member, Flag MemberFlags = Flag::Default, typename CastTo = void>
+        struct SerializedMember;
+
+        template <typename... Members>
+        class SerializedMemberTable;
+
+        // item of deserializeGroup for a table class, see SerializedMemberTable::deserializeGroup
+        template <typename Table>
+        class SerializedMemberTarget;
+
+        // a value of a name no member has, a group is skipped without collecting its keys
+        static Error skipValue(Deserializer *deserializer);
+        static Error skipGroup(Deserializer *deserializer);
+
+        // the group is skipped without collecting its keys, a std::string_view member points into sourceData()
+        // of the deserializer, so the source must outlive the object
+        static Error deserializeRawJson(Deserializer *deserializer, std::string_view &out);
+        static Error deserializeRawJson(Deserializer *deserializer, std::string &out);
+        static Error deserializeRawJson(Deserializer *deserializer, std::pmr::string &out);
+        template <typename M>
+        static constexpr bool isRawJsonType = std::is_base_of<std::string, M>::value || std::is_same<M, std::string_view>::value || std::is_same<M, std::pmr::string>::value;
+        // std::pmr::string and std::pmr::vector members, see SerializedArenaType
+        template <typename M>
+        static Error deserializeArena(Deserializer *deserializer, M &out, const M *defaultValue);
+
         virtual const SerializableMembers &getBindings() const = 0;
       };
 
+      // members allocated from the memory resource they were constructed with. A request decoded into objects
+      // whose pmr members share one std::pmr::monotonic_buffer_resource is freed with a single release(). Values
+      // are decoded in place: strings, vector elements and the pmr members of Serializable elements are all
+      // allocated from the resource of the member, and serialized straight from it
+      template <typename M>
+      struct SerializedArenaType {
+        static constexpr bool value = false;
+      };
+
+      template <>
+      struct SerializedArenaType<std::pmr::string> {
+        static constexpr bool value = true;
+        static std::string_view serialized(const std::pmr::string &value) {
+          return value;
+        }
+      };
+
+      template <typename T>
+      struct SerializedArenaType<std::pmr::vector<T>> {
+        // an element is constructed by emplace_back with the allocator of the vector
+        static_assert(!std::is_base_of<Serializable, T>::value || std::uses_allocator<T, std::pmr::polymorphic_allocator<T>>::value,
+                      "Serializable elements of pmr vectors must be constructible with the allocator of the vector");
+        static constexpr bool value = true;
+        static const std::pmr::vector<T> &serialized(const std::pmr::vector<T> &value) {
+          return value;
+        }
+      };
+
+      template <typename M>
+      Error Serializable::deserializeArena(Deserializer *deserializer, M &out, const M *defaultValue) {
+        if constexpr(std::is_same<M, std::pmr::string>::value) {
+          static const std::pmr::string empty;
+          return deserializer->deserialize(out, defaultValue ? defaultValue : &empty);
+        } else {
+          std::ignore = defaultValue;
+          out.clear();
+          return deserializer->deserializeGroup(
+              out,
+              [](M &out, std::string_view) -> typename M::value_type * {
+                return &out.emplace_back();
+              },
+              Deserializer::DeserializeItemOptions());
+        }
+      }
+
       template <typename T, typename M, typename CastTo>
       Serializable::SerializableMemberInfo::SerializableMemberInfo(std::string_view name, M T::*member, const M &defaultValue, Flags flags, CastTo) :
           name(name),
           serializeHandler([member](const Serializable *_this, Serializer *serializer, std::string_view name) -> Error {
-            return serializer->serialize(name, static_cast<CastTo>(reinterpret_cast<const T *>(_this)->*member));
+            if constexpr(SerializedArenaType<M>::value) {
+              return serializer->serialize(name, SerializedArenaType<M>::serialized(reinterpret_cast<const T *>(_this)->*member));
+            } else {
+              return serializer->serialize(name, static_cast<CastTo>(reinterpret_cast<const T *>(_this)->*member));
+            }
           }),
           deserializeHandler([member, defaultValue, flags](Serializable *_this, Deserializer *deserializer) -> Error {
-            if constexpr(std::is_base_of<std::string, M>::value) {
+            if constexpr(isRawJsonType<M>) {
               if(flags & Flag::RawJson) {
-                Deserializer::OperationResult result = deserializer->deserializeNext();
-                if(result.status() == Deserializer::OperationResult::Status::Fail) {
-                  return MAKE_CHILD_ERROR(deserializer->getLastError(), "Unable to deserialize");
-                }
-                if(result.status() != Deserializer::OperationResult::Status::StartGroup) {
-                  return MAKE_CHILD_ERROR(deserializer->getLastError(), "Service data must be object");
-                }
-                size_t start = deserializer->currentPosition();
-                std::map<std::string, bool> dummy;
-                Error error = deserializer->deserializeGroup(
-                    dummy,
-                    [](std::map<std::string, bool> &out, std::string_view name) -> bool * {
-                      std::pair<std::map<std::string, bool>::iterator, bool> i = out.emplace(std::string(name), false);
-                      return &i.first->second;
-                    },
-                    Deserializer::DeserializeItemOptions(Deserializer::DeserializeItemOption::SkipItem) | Deserializer::DeserializeItemOption::SkipStartTag);
-                if(error.isFail()) {
-                  return MAKE_CHILD_ERROR(error, "Unable to deserialize group");
-                }
-                size_t end = deserializer->currentPosition();
-                reinterpret_cast<T *>(_this)->*member = std::string(reinterpret_cast<const char *>(deserializer->sourceData().data()), start, end - start);
-                return Error::Success;
+                return deserializeRawJson(deserializer, reinterpret_cast<T *>(_this)->*member);
               }
             } else {
               std::ignore = flags;
             }
-            if constexpr(std::is_same<M, CastTo>::value) {
+            if constexpr(std::is_same<M, std::string_view>::value) {
+              std::ignore = defaultValue;
+              return MAKE_ERROR("String view member must be raw json");
+            } else if constexpr(SerializedArenaType<M>::value) {
+              return deserializeArena(deserializer, reinterpret_cast<T *>(_this)->*member, &defaultValue);
+            } else if constexpr(std::is_same<M, CastTo>::value) {
               return deserializer->deserialize(reinterpret_cast<T *>(_this)->*member, &defaultValue);
             } else {
               CastTo v;
@@ -101,6 +192,326 @@
       inline Serializable::SerializableMemberInfo::SerializableMemberInfo(std::string_view _name, SerializeHandler &&_serializeHandler, DeserializeHandler &&_deserializeHandler) :
           name(_name), serializeHandler(std::move(_serializeHandler)), deserializeHandler(std::move(_deserializeHandler)) {}
 
+      inline Error Serializable::deserializeRawJson(Deserializer *deserializer, std::string_view &out) {
+        Deserializer::OperationResult result = deserializer->deserializeNext();
+        if(result.status() == Deserializer::OperationResult::Status::Fail) {
+          return MAKE_CHILD_ERROR(deserializer->getLastError(), "Unable to deserialize");
+        }
+        if(result.status() != Deserializer::OperationResult::Status::StartGroup) {
+          return MAKE_CHILD_ERROR(deserializer->getLastError(), "Service data must be object");
+        }
+        size_t start = deserializer->currentPosition();
+        Error error = skipGroup(deserializer);
+        if(error.isFail()) {
+          return error;
+        }
+        size_t end = deserializer->currentPosition();
+        out = std::string_view(reinterpret_cast<const char *>(deserializer->sourceData().data()) + start, end - start);
+        return Error::Success;
+      }
+
+      // the start of the group is already read
+      inline Error Serializable::skipGroup(Deserializer *deserializer) {
+        // every skipped item lands in the same place
+        bool dummy = false;
+        Error error = deserializer->deserializeGroup(
+            dummy,
+            [](bool &out, std::string_view) -> bool * {
+              return &out;
+            },
+            Deserializer::DeserializeItemOptions(Deserializer::DeserializeItemOption::SkipItem) | Deserializer::DeserializeItemOption::SkipStartTag);
+        if(error.isFail()) {
+          return MAKE_CHILD_ERROR(error, "Unable to deserialize group");
+        }
+        return Error::Success;
+      }
+
+      inline Error Serializable::skipValue(Deserializer *deserializer) {
+        Deserializer::OperationResult result = deserializer->deserializeNext();
+        if(result.status() == Deserializer::OperationResult::Status::Fail) {
+          return MAKE_CHILD_ERROR(deserializer->getLastError(), "Unable to deserialize");
+        }
+        if(result.status() == Deserializer::OperationResult::Status::StartGroup) {
+          return skipGroup(deserializer);
+        }
+        return Error::Success;
+      }
+
+      inline Error Serializable::deserializeRawJson(Deserializer *deserializer, std::string &out) {
+        std::string_view value;
+        Error error = deserializeRawJson(deserializer, value);
+        if(error.isSuccess()) {
+          out.assign(value);
+        }
+        return error;
+      }
+
+      inline Error Serializable::deserializeRawJson(Deserializer *deserializer, std::pmr::string &out) {
+        std::string_view value;
+        Error error = deserializeRawJson(deserializer, value);
+        if(error.isSuccess()) {
+          out.assign(value);
+        }
+        return error;
+      }
+
+      inline size_t Serializable::SerializableMembers::find(std::string_view name) const {
+        if(lookup) {
+          return lookup(name);
+        }
+        std::map<std::string, size_t, std::less<>>::const_iterator i = index.find(name);
+        return i == index.end() ? NotFound : i->second;
+      }
+
+      inline Error Serializable::SerializableMembers::serialize(const Serializable *_this, Serializer *serializer) const {
+        if(serializeMembers) {
+          return serializeMembers(_this, serializer);
+        }
+        for(const SerializableMemberInfo &bind : binds) {
+          Error error = bind.serializeHandler(_this, serializer, bind.name);
+          if(error.isFail()) {
+            return error;
+          }
+        }
+        return Error::Success;
+      }
+
+      inline Error Serializable::SerializableMembers::deserialize(Serializable *_this, Deserializer *deserializer, size_t index) const {
+        if(deserializeMember) {
+          return deserializeMember(_this, deserializer, index);
+        }
+        return binds[index].deserializeHandler(_this, deserializer);
+      }
+
+      inline Serializable::SerializableMembers Serializable::SerializableMembers::inherit(const SerializableMembers &parent, const SerializableMembers &other) {
+        SerializableMembers members = parent + other;
+        members.lookup = nullptr;
+        members.serializeMembers = nullptr;
+        members.deserializeMember = nullptr;
+        return members;
+      }
+
+      template <typename P>
+      struct SerializedMemberPointer;
+
+      template <typename T, typename M>
+      struct SerializedMemberPointer<M T::*> {
+        using Class = T;
+        using Type = M;
+      };
+
+      template <SerializedMemberName Name, auto Member, Serializable::Flag MemberFlags, typename CastTo>
+      struct Serializable::SerializedMember {
+        using Class = typename SerializedMemberPointer<decltype(Member)>::Class;
+        using Type = typename SerializedMemberPointer<decltype(Member)>::Type;
+        using Cast = std::conditional_t<std::is_void<CastTo>::value, Type, CastTo>;
+        static_assert(!std::is_same<Type, std::string_view>::value || (static_cast<int>(MemberFlags) & static_cast<int>(Flag::RawJson)) != 0, "String view member must be raw json");
+        static constexpr std::string_view name = Name.view();
+
+        static Error serialize(const Serializable *_this, Serializer *serializer, std::string_view name) {
+          if constexpr(SerializedArenaType<Type>::value) {
+            return serializer->serialize(name, SerializedArenaType<Type>::serialized(reinterpret_cast<const Class *>(_this)->*Member));
+          } else {
+            return serializer->serialize(name, static_cast<Cast>(reinterpret_cast<const Class *>(_this)->*Member));
+          }
+        }
+
+        static Error deserialize(Serializable *_this, Deserializer *deserializer) {
+          if constexpr(isRawJsonType<Type> && (static_cast<int>(MemberFlags) & static_cast<int>(Flag::RawJson)) != 0) {
+            return deserializeRawJson(deserializer, reinterpret_cast<Class *>(_this)->*Member);
+          } else if constexpr(SerializedArenaType<Type>::value) {
+            return deserializeArena<Type>(deserializer, reinterpret_cast<Class *>(_this)->*Member, nullptr);
+          } else if constexpr(std::is_same<Type, Cast>::value) {
+            static const Type defaultValue = {};
+            return deserializer->deserialize(reinterpret_cast<Class *>(_this)->*Member, &defaultValue);
+          } else {
+            static const Cast defaultValue = static_cast<Cast>(Type{});
+            Cast v;
+            Error error = deserializer->deserialize(v, &defaultValue);
+            if(error.isSuccess()) {
+              reinterpret_cast<Class *>(_this)->*Member = static_cast<Type>(v);
+            }
+            return error;
+          }
+        }
+      };
+
+      // minimal perfect hash over the member names built at compile time (hash and displace): a name picks a
+      // bucket, the displacement of the bucket moves it to a slot no other name uses
+      template <size_t N>
+      struct SerializedMemberHash {
+        static constexpr size_t size = N == 0 ? 1 : std::bit_ceil(N * 2);
+        static constexpr size_t MaxDisplacement = std::numeric_limits<uint16_t>::max();
+        static constexpr size_t NotFound = std::numeric_limits<size_t>::max();
+
+        static constexpr uint64_t hash(std::string_view name) {
+          uint64_t value = 14695981039346656037ull;
+          for(char c : name) {
+            value = (value ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+          }
+          return value ^ (value >> 31);
+        }
+        // every displacement mixes the hash anew: names of a bucket that share a slot for one displacement
+        // are apart for most others
+        static constexpr size_t slot(uint64_t hash, uint16_t displacement) {
+          uint64_t value = hash + (displacement + 1) * 0x9e3779b97f4a7c15ull;
+          value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+          value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+          return static_cast<size_t>((value ^ (value >> 31)) & (size - 1));
+        }
+
+        constexpr SerializedMemberHash(const std::array<std::string_view, N> &names) {
+          std::array<size_t, size> bucketSizes = {};
+          for(size_t i = 0; i < N; i++) {
+            bucketSizes[hash(names[i]) & (size - 1)]++;
+          }
+          // large buckets first while most slots are free
+          for(size_t bucketSize = N; bucketSize > 0; bucketSize--) {
+            for(size_t bucket = 0; bucket < size; bucket++) {
+              if(bucketSizes[bucket] != bucketSize) {
+                continue;
+              }
+              uint16_t displacement = 0;
+              while(!place(names, bucket, displacement)) {
+                if(displacement == MaxDisplacement) {
+                  isValid = false;
+                  return;
+                }
+                displacement++;
+              }
+              displacements[bucket] = displacement;
+            }
+          }
+        }
+
+        constexpr bool place(const std::array<std::string_view, N> &names, size_t bucket, uint16_t displacement) {
+          std::array<uint16_t, size> placed = slots;
+          for(size_t i = 0; i < N; i++) {
+            uint64_t h = hash(names[i]);
+            if((h & (size - 1)) != bucket) {
+              continue;
+            }
+            size_t s = slot(h, displacement);
+            if(placed[s] != 0) {
+              return false;
+            }
+            placed[s] = static_cast<uint16_t>(i + 1);
+          }
+          slots = placed;
+          return true;
+        }
+
+        constexpr size_t find(const std::array<std::string_view, N> &names, std::string_view name) const {
+          uint64_t h = hash(name);
+          uint16_t index = slots[slot(h, displacements[h & (size - 1)])];
+          if(index == 0 || names[index - 1] != name) {
+            return NotFound;
+          }
+          return index - 1;
+        }
+
+        std::array<uint16_t, size> displacements = {};
+        std::array<uint16_t, size> slots = {}; // member index + 1, zero is empty
+        bool isValid = true;
+      };
+
+      // compile time replacement of a SerializableMemberInfo list, see DECLARE_SERIALIZED_MEMBER_TABLE. Name lookup
+      // is a perfect hash and a single compare, serialization is unrolled over the members. A derived class gets
+      // a table of its own over the members of the parent and its own ones, with the hash built for all of them
+      template <typename... Members>
+      class Serializable::SerializedMemberTable {
+      public:
+        template <typename... Others>
+        using Append = SerializedMemberTable<Members..., Others...>;
+
+        static constexpr std::array<std::string_view, sizeof...(Members)> names = {Members::name...};
+        static constexpr SerializedMemberHash<sizeof...(Members)> hash = SerializedMemberHash<sizeof...(Members)>(names);
+        static_assert(hash.isValid, "Unable to build perfect hash of member names, names must be unique");
+
+        static size_t find(std::string_view name) {
+          return hash.find(names, name);
+        }
+
+        static Error serialize(const Serializable *_this, Serializer *serializer) {
+          Error error = Error::Success;
+          ((error = Members::serialize(_this, serializer, Members::name), error.isSuccess()) && ...);
+          return error;
+        }
+
+        static Error deserialize(Serializable *_this, Deserializer *deserializer, size_t index) {
+          return deserialize(_this, deserializer, index, std::index_sequence_for<Members...>());
+        }
+
+        // the group of a table class: names are looked up in the perfect hash and every value is read by the
+        // handler of its member, neither the index nor the std::function of bindings() is used
+        static Error serializeGroup(const Serializable *_this, Serializer *serializer, std::string_view name) {
+          Error error = serializer->startGroup(name);
+          if(error.isSuccess()) {
+            error = serialize(_this, serializer);
+          }
+          if(error.isSuccess()) {
+            error = serializer->endGroup();
+          }
+          return error;
+        }
+
+        static Error deserializeGroup(Serializable *_this, Deserializer *deserializer, bool skipStartTag) {
+          SerializedMemberTarget<SerializedMemberTable> target(_this);
+          return deserializer->deserializeGroup(
+              target,
+              [](SerializedMemberTarget<SerializedMemberTable> &target, std::string_view name) -> SerializedMemberTarget<SerializedMemberTable> * {
+                target.index = find(name);
+                return &target;
+              },
+              skipStartTag ? Deserializer::DeserializeItemOptions(Deserializer::DeserializeItemOption::SkipStartTag) : Deserializer::DeserializeItemOptions());
+        }
+
+        static const SerializableMembers &bindings() {
+          static SerializableMembers bindings = []() {
+            SerializableMembers bindings({SerializableMemberInfo(Members::name, &Members::serialize, &Members::deserialize)...});
+            bindings.lookup = &find;
+            bindings.serializeMembers = &serialize;
+            bindings.deserializeMember = static_cast<Error (*)(Serializable *, Deserializer *, size_t)>(&deserialize);
+            return bindings;
+          }();
+          return bindings;
+        }
+
+      private:
+        template <size_t... I>
+        static Error deserialize(Serializable *_this, Deserializer *deserializer, size_t index, std::index_sequence<I...>) {
+          Error error = Error::Success;
+          if(!((index == I ? (error = Members::deserialize(_this, deserializer), true) : false) || ...)) {
+            return MAKE_ERROR("Unknown member index %zu", index);
+          }
+          return error;
+        }
+      };
+
+      // stands for the member picked by the name of the item, the value is read straight into the object
+      template <typename Table>
+      class Serializable::SerializedMemberTarget final : public Serializable {
+      public:
+        explicit SerializedMemberTarget(Serializable *object) : object_(object) {}
+
+        Error deserialize(Deserializer *deserializer, bool) override {
+          if(index == SerializableMembers::NotFound) {
+            return skipValue(deserializer);
+          }
+          return Table::deserialize(object_, deserializer, index);
+        }
+
+        size_t index = SerializableMembers::NotFound;
+
+      protected:
+        const SerializableMembers &getBindings() const override {
+          return Table::bindings();
+        }
+
+      private:
+        Serializable *object_;
+      };
+
       DECLARE_FLAG_OPERATORS(Serializable::Flags);
 
 #define DECLARE_SERIALIZED_MEMBERS(...)                                                                                                                                            \
@@ -110,10 +521,59 @@ protected:
     return bindings;                                                                                                                                                               \
   }
 
+// DECLARE_SERIALIZED_MEMBER_TABLE(SerializedMember<"id", &Message::id>, SerializedMember<"data", &Message::data, Flag::RawJson>)
+#define DECLARE_SERIALIZED_MEMBER_TABLE(...)                                                                                                                                       \
+public:                                                                                                                                                                            \
+  Error serialize(Serializer *serializer, std::string_view name) const override {                                                                                                  \
+    return SerializedMembers::serializeGroup(this, serializer, name);                                                                                                              \
+  }                                                                                                                                                                                \
+  Error deserialize(Deserializer *deserializer, bool skipStartTag = false) override {                                                                                              \
+    return SerializedMembers::deserializeGroup(this, deserializer, skipStartTag);                                                                                                  \
+  }                                                                                                                                                                                \
+                                                                                                                                                                                   \
+protected:                                                                                                                                                                         \
+  using SerializedMembers = SerializedMemberTable<__VA_ARGS__>;                                                                                                                    \
+  const SerializableMembers &getBindings() const override {                                                                                                                        \
+    return SerializedMembers::bindings();                                                                                                                                          \
+  }
+
+// the parent must declare its members with DECLARE_SERIALIZED_MEMBER_TABLE or this macro
+#define DECLARE_SERIALIZED_MEMBER_TABLE_INHERITED(parent, ...)                                                                                                                     \
+public:                                                                                                                                                                            \
+  Error serialize(Serializer *serializer, std::string_view name) const override {                                                                                                  \
+    return SerializedMembers::serializeGroup(this, serializer, name);                                                                                                              \
+  }                                                                                                                                                                                \
+  Error deserialize(Deserializer *deserializer, bool skipStartTag = false) override {                                                                                              \
+    return SerializedMembers::deserializeGroup(this, deserializer, skipStartTag);                                                                                                  \
+  }                                                                                                                                                                                \
+                                                                                                                                                                                   \
+protected:                                                                                                                                                                         \
+  using SerializedMembers = typename parent::SerializedMembers::template Append<__VA_ARGS__>;                                                                                      \
+  const SerializableMembers &getBindings() const override {                                                                                                                        \
+    return SerializedMembers::bindings();                                                                                                                                          \
+  }
+
+// a table class parent would read the group with its own table, which lacks the members added here
 #define DECLARE_SERIALIZED_MEMBERS_INHERITED(parent, ...)                                                                                                                          \
+public:                                                                                                                                                                            \
+  Error serialize(Serializer *serializer, std::string_view name) const override {                                                                                                  \
+    if constexpr(requires { typename parent::SerializedMembers; }) {                                                                                                               \
+      return Serializable::serialize(serializer, name);                                                                                                                            \
+    } else {                                                                                                                                                                       \
+      return parent::serialize(serializer, name);                                                                                                                                  \
+    }                                                                                                                                                                              \
+  }                                                                                                                                                                                \
+  Error deserialize(Deserializer *deserializer, bool skipStartTag = false) override {                                                                                              \
+    if constexpr(requires { typename parent::SerializedMembers; }) {                                                                                                               \
+      return Serializable::deserialize(deserializer, skipStartTag);                                                                                                                \
+    } else {                                                                                                                                                                       \
+      return parent::deserialize(deserializer, skipStartTag);                                                                                                                      \
+    }                                                                                                                                                                              \
+  }                                                                                                                                                                                \
+                                                                                                                                                                                   \
 protected:                                                                                                                                                                         \
   const SerializableMembers &getBindings() const override {                                                                                                                        \
-    static SerializableMembers bindings = parent::getBindings() + SerializableMembers(__VA_ARGS__);                                                                                \
+    static SerializableMembers bindings = SerializableMembers::inherit(parent::getBindings(), SerializableMembers(__VA_ARGS__));                                                   \
     return bindings;                                                                                                                                                               \
   }
 
@@ -0,0 +1,217 @@
+#include "serializable.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <string>
+
+// behaviour of the member tables of Serializable, each object is serialized to json and read back into a
+// fresh one, built the same way as jsonbench
+//
+//   serializabletest
+
+using namespace core::serializers;
+
+namespace {
+  std::atomic<size_t> heapAllocations = 0;
+}
+
+void *operator new(size_t size) {
+  heapAllocations++;
+  if(void *p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+void operator delete(void *p, size_t) noexcept {
+  std::free(p);
+}
+
+namespace {
+  class Base : public Serializable {
+  public:
+    int64_t id = 0;
+    std::string name;
+
+    DECLARE_SERIALIZED_MEMBER_TABLE(SerializedMember<"id", &Base::id>, SerializedMember<"name", &Base::name>)
+  };
+
+  class Derived : public Base {
+  public:
+    std::string role;
+    bool isAdmin = false;
+
+    DECLARE_SERIALIZED_MEMBER_TABLE_INHERITED(Base, SerializedMember<"role", &Derived::role>, SerializedMember<"is_admin", &Derived::isAdmin>)
+
+  public:
+    static size_t find(std::string_view name) {
+      return SerializedMembers::find(name);
+    }
+  };
+
+  class MappedDerived : public Base {
+  public:
+    std::string role;
+
+    DECLARE_SERIALIZED_MEMBERS_INHERITED(Base, {{"role", &MappedDerived::role}})
+  };
+
+  class Device : public Serializable {
+  public:
+    using allocator_type = std::pmr::polymorphic_allocator<Device>;
+
+  public:
+    explicit Device(const allocator_type &allocator = {}) : name(allocator), keys(allocator) {}
+    Device(const Device &other, const allocator_type &allocator) : Serializable(other), name(other.name, allocator), keys(other.keys, allocator) {}
+
+    std::pmr::string name;
+    std::pmr::vector<std::pmr::string> keys;
+
+    DECLARE_SERIALIZED_MEMBER_TABLE(SerializedMember<"name", &Device::name>, SerializedMember<"keys", &Device::keys>)
+  };
+
+  class Group : public Serializable {
+  public:
+    explicit Group(std::pmr::memory_resource *resource) : id(resource), memberIds(resource), devices(resource) {}
+
+    std::pmr::string id;
+    std::pmr::vector<int64_t> memberIds;
+    std::pmr::vector<Device> devices;
+
+    DECLARE_SERIALIZED_MEMBER_TABLE(SerializedMember<"id", &Group::id>, SerializedMember<"member_ids", &Group::memberIds>, SerializedMember<"devices", &Group::devices>)
+  };
+
+  struct Test {
+    const char *name;
+    std::function<const char *()> run;
+  };
+
+  template <typename T>
+  Error roundTrip(const T &in, T &out) {
+    Serializer serializer;
+    Error error = in.serialize(&serializer, {});
+    if(error.isFail()) {
+      return error;
+    }
+    Deserializer deserializer(serializer.data());
+    return out.deserialize(&deserializer);
+  }
+
+  // members of the parent and of the derived class are found in one table and survive a round trip
+  const char *derivedTable() {
+    for(std::string_view name : {"id", "name", "role", "is_admin"}) {
+      if(Derived::find(name) == SerializedMemberHash<4>::NotFound) {
+        return "member missing from the derived table";
+      }
+    }
+    Derived in;
+    in.id = 42;
+    in.name = "member";
+    in.role = "owner";
+    in.isAdmin = true;
+    Derived out;
+    if(roundTrip(in, out).isFail()) {
+      return "round trip failed";
+    }
+    if(out.id != in.id || out.name != in.name || out.role != in.role || out.isAdmin != in.isAdmin) {
+      return "round trip lost a member";
+    }
+    return nullptr;
+  }
+
+  // names of no member are skipped with their whole value, the members around them are still read
+  const char *unknownMembers() {
+    Deserializer deserializer(std::string_view(R"({"id":5,"extra":{"a":[1,{"b":"}"}]},"tags":[1,2],"name":"member","flag":true})"));
+    Base out;
+    if(out.deserialize(&deserializer).isFail()) {
+      return "deserialize failed";
+    }
+    if(out.id != 5 || out.name != "member") {
+      return "member after an unknown one is lost";
+    }
+    return nullptr;
+  }
+
+  // a class inheriting with a member list from a table class does not keep the lookup of the parent table
+  const char *mappedDerived() {
+    MappedDerived in;
+    in.id = 7;
+    in.name = "member";
+    in.role = "admin";
+    MappedDerived out;
+    if(roundTrip(in, out).isFail()) {
+      return "round trip failed";
+    }
+    if(out.id != in.id || out.name != in.name || out.role != in.role) {
+      return "round trip lost a member";
+    }
+    return nullptr;
+  }
+
+  // pmr members, elements and the members of nested objects are decoded into the arena, the heap is untouched
+  const char *pmrArena() {
+    Group in(std::pmr::get_default_resource());
+    in.id = std::string(64, 'g');
+    for(int64_t i = 0; i < 100; i++) {
+      in.memberIds.push_back(i);
+      Device &device = in.devices.emplace_back();
+      device.name = "device " + std::to_string(i) + std::string(32, 'd');
+      device.keys.emplace_back(128, 'k');
+      device.keys.emplace_back(128, 'l');
+    }
+    Serializer serializer;
+    if(in.serialize(&serializer, {}).isFail()) {
+      return "serialize failed";
+    }
+    Deserializer deserializer(serializer.data());
+
+    std::vector<char> buffer(1024 * 1024);
+    std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+    Group out(&arena);
+    size_t allocations = heapAllocations;
+    Error error = out.deserialize(&deserializer);
+    allocations = heapAllocations - allocations;
+    if(error.isFail()) {
+      return "deserialize failed";
+    }
+    if(allocations != 0) {
+      return "heap is used";
+    }
+    if(out.id != in.id || out.memberIds != in.memberIds || out.devices.size() != in.devices.size()) {
+      return "round trip lost a member";
+    }
+    for(size_t i = 0; i < in.devices.size(); i++) {
+      const Device &device = out.devices[i];
+      if(device.name != in.devices[i].name || device.keys != in.devices[i].keys) {
+        return "round trip lost a nested member";
+      }
+      if(device.name.get_allocator().resource() != &arena || device.keys.get_allocator().resource() != &arena || device.keys[0].get_allocator().resource() != &arena) {
+        return "nested member is not in the arena";
+      }
+    }
+    return nullptr;
+  }
+} // namespace
+
+int main() {
+  const Test tests[] = {
+      {"derived table", derivedTable},
+      {"unknown members", unknownMembers},
+      {"mapped derived", mappedDerived},
+      {"pmr arena", pmrArena},
+  };
+  size_t failed = 0;
+  for(const Test &test : tests) {
+    const char *failure = test.run();
+    std::printf("%-24s %s\n", test.name, failure ? failure : "ok");
+    if(failure) {
+      failed++;
+    }
+  }
+  return failed == 0 ? 0 : 1;
+}